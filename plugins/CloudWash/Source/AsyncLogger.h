@@ -0,0 +1,248 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+//==============================================================================
+// Compile-time level filter. Calls below this level compile to nothing,
+// including their argument evaluation. Override with -DCLOUDWASH_LOG_LEVEL=n
+// (0 trace, 1 debug, 2 info, 3 warning, 4 error, 5 off).
+#ifndef CLOUDWASH_LOG_LEVEL
+ #if JUCE_DEBUG
+  #define CLOUDWASH_LOG_LEVEL 1
+ #else
+  #define CLOUDWASH_LOG_LEVEL 3
+ #endif
+#endif
+
+/** Logs from any thread except the audio thread. May block briefly. */
+#define CLOUDWASH_LOG(logger, level, ...) \
+    do { if constexpr ((int) (level) >= CLOUDWASH_LOG_LEVEL) (logger).log ((level), __VA_ARGS__); } while (false)
+
+/** Logs from the audio thread. Wait-free; the message is dropped if the ring is full. */
+#define CLOUDWASH_LOG_RT(logger, level, ...) \
+    do { if constexpr ((int) (level) >= CLOUDWASH_LOG_LEVEL) (logger).logRealtime ((level), __VA_ARGS__); } while (false)
+
+//==============================================================================
+/**
+ * Asynchronous file logger that is safe to call from the audio callback.
+ *
+ * Messages are formatted (printf-style) into fixed-size records in place and
+ * pushed into lock-free SPSC rings: one owned by the audio thread, and one
+ * shared by every other thread behind a mutex. A background writer drains
+ * both rings and does all file I/O. Nothing on the realtime path allocates,
+ * locks or touches the file system.
+ *
+ * The log file is chosen in start(): by default the CLOUDWASH_LOG_FILE
+ * environment variable, else <user app data>/CloudWash/CloudWash.log.
+ */
+class AsyncLogger
+{
+public:
+    enum Level
+    {
+        levelTrace,
+        levelDebug,
+        levelInfo,
+        levelWarning,
+        levelError
+    };
+
+    static constexpr int kMaxMessageLength = 160;
+    static constexpr int kRingSize = 256;  // Records per ring, power of two
+
+    AsyncLogger() = default;
+    ~AsyncLogger() { stop(); }
+
+    /** Opens the log file and starts the writer thread. Message thread only. */
+    void start (const juce::File& logFile = getDefaultLogFile())
+    {
+        if constexpr (CLOUDWASH_LOG_LEVEL > levelError)
+            return;
+
+        stop();
+
+        if (logFile.getFullPathName().isNotEmpty())
+        {
+            logFile.getParentDirectory().createDirectory();
+            auto fileStream = std::make_unique<juce::FileOutputStream> (logFile);
+            if (fileStream->openedOk())
+                stream = std::move (fileStream);
+        }
+
+        writer.startThread (juce::Thread::Priority::background);
+    }
+
+    /** Stops the writer after draining everything still queued. */
+    void stop()
+    {
+        if (writer.isThreadRunning())
+            writer.stopThread (1000);
+
+        drain();
+        stream.reset();
+    }
+
+    /** Any non-audio thread. Serialised with a mutex, never dropped unless full. */
+    void log (Level level, const char* format, ...)
+    {
+        std::lock_guard<std::mutex> lock (generalMutex);
+
+        va_list args;
+        va_start (args, format);
+        push (generalRing, droppedGeneral, level, format, args);
+        va_end (args);
+    }
+
+    /** Audio thread only (single producer). */
+    void logRealtime (Level level, const char* format, ...)
+    {
+        va_list args;
+        va_start (args, format);
+        push (realtimeRing, droppedRealtime, level, format, args);
+        va_end (args);
+    }
+
+    static juce::File getDefaultLogFile()
+    {
+        auto path = juce::SystemStats::getEnvironmentVariable ("CLOUDWASH_LOG_FILE", {});
+        if (path.isNotEmpty())
+            return juce::File (path);
+
+        return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+                   .getChildFile ("CloudWash")
+                   .getChildFile ("CloudWash.log");
+    }
+
+private:
+    struct Record
+    {
+        double timeMs;
+        int level;
+        char text[kMaxMessageLength];
+    };
+
+    // Single-producer single-consumer ring. The producer formats straight into
+    // the free slot, then publishes it with a release store.
+    class Ring
+    {
+    public:
+        Record* beginWrite()
+        {
+            const auto h = head.load (std::memory_order_relaxed);
+            if (h - tail.load (std::memory_order_acquire) >= (uint32_t) kRingSize)
+                return nullptr;
+            return &records[h & (kRingSize - 1)];
+        }
+
+        void finishWrite() { head.store (head.load (std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+        const Record* beginRead()
+        {
+            const auto t = tail.load (std::memory_order_relaxed);
+            if (t == head.load (std::memory_order_acquire))
+                return nullptr;
+            return &records[t & (kRingSize - 1)];
+        }
+
+        void finishRead() { tail.store (tail.load (std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    private:
+        std::array<Record, kRingSize> records;
+        std::atomic<uint32_t> head { 0 };
+        std::atomic<uint32_t> tail { 0 };
+    };
+
+    static_assert ((kRingSize & (kRingSize - 1)) == 0, "Ring size must be a power of two");
+
+    class WriterThread : public juce::Thread
+    {
+    public:
+        explicit WriterThread (AsyncLogger& o) : juce::Thread ("CloudWash Logger"), owner (o) {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                owner.drain();
+                wait (50);
+            }
+        }
+
+    private:
+        AsyncLogger& owner;
+    };
+
+    static void push (Ring& ring, std::atomic<uint32_t>& dropped, Level level, const char* format, va_list args)
+    {
+        auto* record = ring.beginWrite();
+        if (record == nullptr)
+        {
+            dropped.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+
+        record->timeMs = juce::Time::getMillisecondCounterHiRes();
+        record->level = level;
+        std::vsnprintf (record->text, sizeof (record->text), format, args);
+        ring.finishWrite();
+    }
+
+    // Writer thread (or stop()). The only place that touches the file.
+    void drain()
+    {
+        bool wroteAnything = drainRing (generalRing, droppedGeneral);
+        wroteAnything = drainRing (realtimeRing, droppedRealtime) || wroteAnything;
+
+        if (wroteAnything && stream != nullptr)
+            stream->flush();
+    }
+
+    bool drainRing (Ring& ring, std::atomic<uint32_t>& dropped)
+    {
+        bool wroteAnything = false;
+
+        while (const auto* record = ring.beginRead())
+        {
+            writeLine (record->timeMs, record->level, record->text);
+            ring.finishRead();
+            wroteAnything = true;
+        }
+
+        if (const auto numDropped = dropped.exchange (0, std::memory_order_relaxed))
+        {
+            writeLine (juce::Time::getMillisecondCounterHiRes(), levelWarning,
+                       (juce::String (numDropped) + " log messages dropped (ring full)").toRawUTF8());
+            wroteAnything = true;
+        }
+
+        return wroteAnything;
+    }
+
+    void writeLine (double timeMs, int level, const char* text)
+    {
+        static const char* const levelNames[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+
+        const auto line = juce::String (timeMs / 1000.0, 3) + " [" + levelNames[juce::jlimit (0, 4, level)] + "] " + text;
+        DBG (line);
+
+        if (stream != nullptr)
+            *stream << line << juce::newLine;
+    }
+
+    Ring realtimeRing;
+    Ring generalRing;
+    std::atomic<uint32_t> droppedRealtime { 0 };
+    std::atomic<uint32_t> droppedGeneral { 0 };
+    std::mutex generalMutex;
+
+    std::unique_ptr<juce::FileOutputStream> stream;
+    WriterThread writer { *this };
+
+    JUCE_DECLARE_NON_COPYABLE (AsyncLogger)
+};
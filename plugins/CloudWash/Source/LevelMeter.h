@@ -0,0 +1,89 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+/**
+ * Stereo peak + RMS meter fed from inside existing per-sample loops. With
+ * more channels, their accumulators are merged pair by pair.
+ *
+ * A loop that already touches the samples folds them, two stereo frames at a
+ * time, into an Accumulator: four independent lanes of running peak and sum
+ * of squares that the compiler keeps in one SIMD register. The finished
+ * accumulator is handed to addChunk(), which applies the ballistics: instant
+ * attack, and an exponential release whose decay depends on the number of
+ * samples, not on how they were split into blocks.
+ *
+ * Audio thread only; the owner publishes getPeak()/getRms() where needed.
+ */
+class LevelMeter
+{
+public:
+    static constexpr float kDefaultReleaseSeconds = 0.38f;
+
+    LevelMeter() = default;
+
+    struct Accumulator
+    {
+        /** Two stereo frames: (l0, r0, l1, r1). */
+        inline void add (float l0, float r0, float l1, float r1) noexcept
+        {
+            const float x[4] = { l0, r0, l1, r1 };
+            for (int k = 0; k < 4; ++k)
+            {
+                peak[k] = std::max (peak[k], std::abs (x[k]));
+                sumSquares[k] += x[k] * x[k];
+            }
+        }
+
+        /** Folds in another accumulator, e.g. from another channel pair. */
+        inline void merge (const Accumulator& other) noexcept
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                peak[k] = std::max (peak[k], other.peak[k]);
+                sumSquares[k] += other.sumSquares[k];
+            }
+        }
+
+        float peak[4] {};
+        float sumSquares[4] {};
+    };
+
+    /** Sets the release time for chunks of chunkSize samples at sampleRate. */
+    void prepare (double sampleRate, int chunkSize, float releaseSeconds = kDefaultReleaseSeconds)
+    {
+        chunkDecay = (float) std::exp (-(double) chunkSize / ((double) releaseSeconds * sampleRate));
+        reset();
+    }
+
+    void reset()
+    {
+        peakLevel = 0.0f;
+        meanSquare = 0.0f;
+    }
+
+    /** Audio thread: folds one chunk of numFrames stereo frames into the meter
+        (numFrames times the number of merged pairs, for merged accumulators). */
+    void addChunk (const Accumulator& a, int numFrames) noexcept
+    {
+        const float chunkPeak = std::max (std::max (a.peak[0], a.peak[1]), std::max (a.peak[2], a.peak[3]));
+        const float chunkMeanSquare = ((a.sumSquares[0] + a.sumSquares[1]) + (a.sumSquares[2] + a.sumSquares[3]))
+                                      / (float) (2 * numFrames);
+
+        peakLevel = std::max (chunkPeak, peakLevel * chunkDecay);
+        meanSquare += (chunkMeanSquare - meanSquare) * (1.0f - chunkDecay);
+    }
+
+    float getPeak() const noexcept { return peakLevel; }
+    float getRms() const noexcept  { return std::sqrt (meanSquare); }
+
+private:
+    float chunkDecay = 0.0f;
+    float peakLevel = 0.0f;
+    float meanSquare = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE (LevelMeter)
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <array>
+#include <atomic>
+
+/**
+ * Lock-free parameter access, indexed at compile time.
+ * IdType is an enum whose values index the ID list given to initialize().
+ * Reads are a single relaxed atomic load: no hashing, string compares or RTTI.
+ * Choice parameters read as their index, bool parameters as 0 or 1.
+ */
+template <typename IdType, size_t NumParams>
+class ParameterTable
+{
+public:
+    ParameterTable() = default;
+
+    void initialize(juce::AudioProcessorValueTreeState& apvts, const std::array<const char*, NumParams>& paramIDs)
+    {
+        for (size_t i = 0; i < NumParams; ++i)
+        {
+            parameters[i] = apvts.getParameter(paramIDs[i]);
+            values[i] = apvts.getRawParameterValue(paramIDs[i]);
+
+            // Every ID in the table must exist in the layout
+            jassert(parameters[i] != nullptr && values[i] != nullptr);
+            if (values[i] == nullptr)
+                values[i] = &fallback;
+        }
+    }
+
+    // Fast, lock-free access by compile-time ID
+    template <IdType id>
+    float get() const
+    {
+        static_assert(static_cast<size_t>(id) < NumParams, "Parameter ID out of range");
+        return values[static_cast<size_t>(id)]->load(std::memory_order_relaxed);
+    }
+
+    template <IdType id>
+    int getIndex() const { return static_cast<int>(get<id>() + 0.5f); }
+
+    template <IdType id>
+    bool getBool() const { return get<id>() >= 0.5f; }
+
+    // Parameter object for message-thread writes and host notification
+    template <IdType id>
+    juce::RangedAudioParameter* getParameter() const
+    {
+        static_assert(static_cast<size_t>(id) < NumParams, "Parameter ID out of range");
+        return parameters[static_cast<size_t>(id)];
+    }
+
+    juce::RangedAudioParameter* getParameter(size_t index) const
+    {
+        return index < NumParams ? parameters[index] : nullptr;
+    }
+
+private:
+    std::array<std::atomic<float>*, NumParams> values {};
+    std::array<juce::RangedAudioParameter*, NumParams> parameters {};
+    std::atomic<float> fallback { 0.0f };
+};
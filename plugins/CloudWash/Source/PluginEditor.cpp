@@ -156,8 +156,9 @@ void CloudWashAudioProcessorEditor::timerCallback()
     float inputLevel = audioProcessor.inputPeakLevel.load();
     float outputLevel = audioProcessor.outputPeakLevel.load();
 
-    // Get grain visualization data
-    int activeGrains = audioProcessor.activeGrainCount.load();
+    // Get grain visualization data (latest snapshot from the audio thread)
+    audioProcessor.grainTelemetry.update();
+    const auto& grains = audioProcessor.grainTelemetry.getReadBuffer();
     float density = audioProcessor.grainDensityViz.load();
     float texture = audioProcessor.grainTextureViz.load();
 
@@ -168,14 +169,24 @@ void CloudWashAudioProcessorEditor::timerCallback()
         // Update meters
         juce::String metersJS = "if (window.updateMeters) { window.updateMeters(" +
                                 juce::String(inputLevel, 3) + ", " +
-                                juce::String(outputLevel, 3) + "); }";
+                                juce::String(outputLevel, 3) + ", " +
+                                juce::String(audioProcessor.inputRmsLevel.load(), 3) + ", " +
+                                juce::String(audioProcessor.outputRmsLevel.load(), 3) + "); }";
         webView->evaluateJavascript(metersJS);
 
         // Update grain visualization
         juce::String grainVizJS = "if (window.updateGrainVisualization) { window.updateGrainVisualization(" +
-                                  juce::String(activeGrains) + ", " +
+                                  juce::String(grains.activeGrains) + ", " +
                                   juce::String(density, 3) + ", " +
-                                  juce::String(texture, 3) + "); }";
+                                  juce::String(texture, 3) + ", {" +
+                                  "pool: " + juce::String(grains.poolSize) + ", " +
+                                  "low: " + juce::String(grains.grainsPerQuality[clouds::GRAIN_QUALITY_LOW]) + ", " +
+                                  "medium: " + juce::String(grains.grainsPerQuality[clouds::GRAIN_QUALITY_MEDIUM]) + ", " +
+                                  "high: " + juce::String(grains.grainsPerQuality[clouds::GRAIN_QUALITY_HIGH]) + ", " +
+                                  "gain: " + juce::String(grains.gainNormalization, 3) + ", " +
+                                  "writeHead: " + juce::String(grains.writeHead, 4) + ", " +
+                                  "budget: " + juce::String(grains.grainBudget, 3) + ", " +
+                                  "load: " + juce::String(grains.cpuLoad, 3) + "}); }";
         webView->evaluateJavascript(grainVizJS);
     }
     catch (...)
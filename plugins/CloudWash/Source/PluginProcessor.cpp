@@ -1,14 +1,12 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include <fstream>
 
-// Emergency crash logging to file
-static void CRASH_LOG(const juce::String& msg) {
-    std::ofstream log("R:\\_VST_Development_2026\\audio-plugin-coder\\cloudwash_crash_log.txt", std::ios::app);
-    log << msg.toStdString() << std::endl;
-    log.flush();
-    DBG(msg);
-}
+// Diagnostics go through this instance's AsyncLogger (no file I/O on the caller)
+#define LOG_DEBUG(...)    CLOUDWASH_LOG (logger, AsyncLogger::levelDebug, __VA_ARGS__)
+#define LOG_INFO(...)     CLOUDWASH_LOG (logger, AsyncLogger::levelInfo, __VA_ARGS__)
+#define LOG_ERROR(...)    CLOUDWASH_LOG (logger, AsyncLogger::levelError, __VA_ARGS__)
+#define LOG_RT_TRACE(...) CLOUDWASH_LOG_RT (logger, AsyncLogger::levelTrace, __VA_ARGS__)
+#define LOG_RT_ERROR(...) CLOUDWASH_LOG_RT (logger, AsyncLogger::levelError, __VA_ARGS__)
 
 //==============================================================================
 CloudWashAudioProcessor::CloudWashAudioProcessor()
@@ -17,6 +15,7 @@ CloudWashAudioProcessor::CloudWashAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
@@ -26,19 +25,22 @@ CloudWashAudioProcessor::CloudWashAudioProcessor()
 #endif
       apvts (*this, nullptr, "Parameters", createParameterLayout())
 {
+    logger.start();
     DBG("CloudWash: Constructor started");
 
     // CRITICAL FIX: Defer ALL Clouds initialization to prepareToPlay()
     // This ensures JUCE is fully initialized before we touch Clouds
-    processor = nullptr;
-    block_mem = nullptr;
-    block_ccm = nullptr;
 
     // Initialize current mode/quality state (atomic stores for thread safety)
     DBG("CloudWash: Setting initial state");
     currentMode.store(0);  // PLAYBACK_MODE_GRANULAR
     currentQuality.store(0);  // Hi-Fi Stereo
 
+    // Resolve every parameter once; processBlock() only touches the atomics
+    parameterTable.initialize(apvts, parameterIds);
+    apvts.addParameterListener(parameterIds[(size_t)ParamId::engineRate], this);
+    startTimer(kHostUpdateIntervalMs);
+
     // Initialize presets
     DBG("CloudWash: Initializing presets");
     initializePresets();
@@ -48,11 +50,90 @@ CloudWashAudioProcessor::CloudWashAudioProcessor()
 
 CloudWashAudioProcessor::~CloudWashAudioProcessor()
 {
-    // Clean up heap-allocated Clouds processor and buffers
-    delete processor;
+    apvts.removeParameterListener(parameterIds[(size_t)ParamId::engineRate], this);
+    stopTimer();
+
+    // Stop the workers before their engines go away
+    engineSwitchThread.stopThread(2000);
+    channelPairWorkers.stop();
+    spectralWorker.stop();
+
+    // Clean up heap-allocated Clouds processors and buffers
+    for (auto& pair : channelPairs)
+        for (auto& slot : pair.engineSlots)
+            releaseEngineSlot(slot);
+}
+
+void CloudWashAudioProcessor::initialiseEngineSlot (EngineSlot& slot, int longBufferSeconds)
+{
+    // Hardware sizes (STM32 SRAM and CCM), or a heap-sized long buffer:
+    // 16-bit stereo at the engine rate in the small block, the same plus the
+    // FX workspace in the large one (see clouds::WorkspaceSize()). Above
+    // 32kHz everything grows with the rate so recording times stay the same;
+    // the small block must still hold the workspace for the mono qualities.
+    const double sampleRate = internalSampleRate;
+    const double scale = sampleRate / kHardwareSampleRate;
+    const size_t workspaceSize = clouds::WorkspaceSize((float)sampleRate);
+    size_t ccmLen = (size_t)((65536 - 128) * scale);
+    if (longBufferSeconds > 0)
+        ccmLen = (size_t)longBufferSeconds * (size_t)sampleRate * sizeof(int16_t);
+    ccmLen = std::max(ccmLen, workspaceSize);
+    size_t memLen = std::max((size_t)(118784 * scale), ccmLen + workspaceSize);
+
+    // Whole 32-bit words: saved recordings are walked word by word (see
+    // GranularProcessor::LoadPersistentData()).
+    ccmLen = (ccmLen + 3) & ~(size_t)3;
+    memLen = (memLen + 3) & ~(size_t)3;
+
+    // The spectral worker may still be busy with this engine's last frames
+    spectralWorker.waitUntilIdle();
+
+    // Memory only grows; a slot going back to hardware sizes keeps its
+    // allocation for the next long-buffer switch.
+    if (memLen > slot.memCapacity || ccmLen > slot.ccmCapacity)
+    {
+        LOG_DEBUG("Engine: allocating block_mem (%d bytes) and block_ccm (%d bytes)", (int)memLen, (int)ccmLen);
+        free(slot.block_mem);
+        free(slot.block_ccm);
+        slot.block_mem = (uint8_t*)calloc(memLen, 1);
+        slot.block_ccm = (uint8_t*)calloc(ccmLen, 1);
+        slot.memCapacity = memLen;
+        slot.ccmCapacity = ccmLen;
+    }
+
+    if (slot.processor == nullptr)
+    {
+        slot.processor = new clouds::GranularProcessor();
+        LOG_DEBUG("Engine: GranularProcessor at %p (%d bytes)", (void*)slot.processor, (int)sizeof(*slot.processor));
+    }
+
+    memset(slot.processor, 0, sizeof(*slot.processor));
+    slot.processor->set_sample_rate((float)sampleRate);
+    slot.processor->set_async_spectral(true);
+    slot.processor->Init(slot.block_mem, memLen, slot.block_ccm, ccmLen);
+    slot.longBufferSeconds = longBufferSeconds;
+    slot.sampleRate = sampleRate;
+    LOG_DEBUG("Engine: Init() complete (%.0f Hz, long buffer %d s)", sampleRate, longBufferSeconds);
+}
+
+CloudWashAudioProcessor::EngineSlot& CloudWashAudioProcessor::getEngineSlot (clouds::GranularProcessor* engine)
+{
+    for (auto& pair : channelPairs)
+        for (auto& slot : pair.engineSlots)
+            if (slot.processor == engine)
+                return slot;
+
+    jassertfalse;
+    return channelPairs[0].engineSlots[0];
+}
+
+void CloudWashAudioProcessor::releaseEngineSlot (EngineSlot& slot)
+{
+    delete slot.processor;
     // Use free() since we used calloc() for these buffers
-    free(block_mem);
-    free(block_ccm);
+    free(slot.block_mem);
+    free(slot.block_ccm);
+    slot = EngineSlot();
 }
 
 //==============================================================================
@@ -90,12 +171,12 @@ bool CloudWashAudioProcessor::isMidiEffect() const
 
 double CloudWashAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load(std::memory_order_relaxed);
 }
 
 int CloudWashAudioProcessor::getNumPrograms()
 {
-    return (int)presets.size();
+    return kNumPresets;
 }
 
 int CloudWashAudioProcessor::getCurrentProgram()
@@ -105,7 +186,7 @@ int CloudWashAudioProcessor::getCurrentProgram()
 
 void CloudWashAudioProcessor::setCurrentProgram (int index)
 {
-    if (index >= 0 && index < (int)presets.size())
+    if (index >= 0 && index < kNumPresets)
     {
         currentPresetIndex = index;
         loadPreset(index);
@@ -114,15 +195,15 @@ void CloudWashAudioProcessor::setCurrentProgram (int index)
 
 const juce::String CloudWashAudioProcessor::getProgramName (int index)
 {
-    if (index >= 0 && index < (int)presets.size())
-        return presets[index].name;
+    if (index >= 0 && index < kNumPresets)
+        return presets[(size_t)index].name;
     return "Invalid";
 }
 
 void CloudWashAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
-    if (index >= 0 && index < (int)presets.size())
-        presets[index].name = newName;
+    if (index >= 0 && index < kNumPresets)
+        presets[(size_t)index].name = newName;
 }
 
 //==============================================================================
@@ -130,79 +211,186 @@ void CloudWashAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBl
 {
     DBG("CloudWash: prepareToPlay called");
 
-    // CRITICAL FIX: Initialize Clouds processor here instead of constructor
-    // This ensures JUCE is fully initialized before we touch Clouds
-    // Use atomic flag to ensure we only initialize once (prepareToPlay can be called multiple times)
-    if (!cloudsInitialized.load())
-    {
-        CRASH_LOG("==== CloudWash prepareToPlay - First-time Clouds initialization ====");
+    const double engineSampleRate = getEngineSampleRate(sampleRate);
 
-        const int memLen = 118784;
-        const int ccmLen = 65536 - 128;
+    // Cancels any mode/quality switch in flight below; the worker cannot be
+    // inside prepareShadowEngine(), nor getStateInformation() reading an
+    // engine, while we hold the lock.
+    std::lock_guard<std::mutex> lock(processorMutex);
 
-        CRASH_LOG("Step 1: Allocating block_mem (" + juce::String(memLen) + " bytes)...");
-        block_mem = (uint8_t*)calloc(memLen, 1);
-        CRASH_LOG("Step 2: block_mem allocated at " + juce::String::toHexString((juce::pointer_sized_uint)block_mem));
+    engineSwitchState.store(engineSwitchIdle, std::memory_order_release);
+    crossfadePosition = 0;
 
-        CRASH_LOG("Step 3: Allocating block_ccm (" + juce::String(ccmLen) + " bytes)...");
-        block_ccm = (uint8_t*)calloc(ccmLen, 1);
-        CRASH_LOG("Step 4: block_ccm allocated at " + juce::String::toHexString((juce::pointer_sized_uint)block_ccm));
+    hostSampleRate = sampleRate;
+    internalSampleRate = engineSampleRate;
 
-        CRASH_LOG("Step 5: About to call 'new clouds::GranularProcessor()'...");
-        processor = new clouds::GranularProcessor();
-        CRASH_LOG("Step 6: GranularProcessor allocated at " + juce::String::toHexString((juce::pointer_sized_uint)processor));
+    // One engine pair per channel pair of the layout
+    assignChannelPairs(getChannelLayoutOfBus(false, 0));
+    const int numChannels = numBusChannels;
 
-        CRASH_LOG("Step 7: About to memset processor (size=" + juce::String(sizeof(*processor)) + ")...");
-        memset(processor, 0, sizeof(*processor));
-        CRASH_LOG("Step 8: Processor memset complete");
+    // CRITICAL FIX: Initialize Clouds processor here instead of constructor
+    // This ensures JUCE is fully initialized before we touch Clouds
+    // A pair gets its engines the first time a layout uses it, with the
+    // memory of the first pair's active engine (hardware sizes to start with;
+    // a saved Ultra HQ quality arrives as an ordinary quality switch on the
+    // first block).
+    const int activeLongBufferSeconds = channelPairs[0].processor != nullptr
+        ? getEngineSlot(channelPairs[0].processor).longBufferSeconds
+        : 0;
+    for (int i = 0; i < numChannelPairs; ++i)
+    {
+        auto& pair = channelPairs[i];
+        if (pair.processor == nullptr)
+        {
+            LOG_INFO("prepareToPlay: Clouds initialization for channel pair %d", i + 1);
+            initialiseEngineSlot(pair.engineSlots[0], activeLongBufferSeconds);
+            initialiseEngineSlot(pair.engineSlots[1], 0);
+            pair.processor = pair.engineSlots[0].processor;
+            pair.shadowProcessor = pair.engineSlots[1].processor;
+        }
 
-        CRASH_LOG("Step 9: About to call processor->Init()...");
-        processor->Init(block_mem, memLen, block_ccm, ccmLen);
-        CRASH_LOG("Step 10: Init() COMPLETED SUCCESSFULLY!");
+        // A new engine rate re-sizes both engines; the recording is lost.
+        // So does a pair coming back after a long-buffer switch it missed.
+        for (auto& slot : pair.engineSlots)
+            if (slot.sampleRate != internalSampleRate)
+                initialiseEngineSlot(slot, slot.longBufferSeconds);
 
-        // Mark as initialized so we don't do this again
-        cloudsInitialized.store(true);
-        CRASH_LOG("==== Clouds initialization complete - NO CRASH ====");
+        auto& activeSlot = getEngineSlot(pair.processor);
+        if (activeSlot.longBufferSeconds != activeLongBufferSeconds)
+            initialiseEngineSlot(activeSlot, activeLongBufferSeconds);
     }
-    else
+    for (int i = 0; i < numChannelPairs; ++i)
     {
-        CRASH_LOG("prepareToPlay: Clouds already initialized, skipping...");
+        channelPairs[i].recordingEngine.store(channelPairs[i].processor, std::memory_order_relaxed);
+        channelPairs[i].recordingHead.store(channelPairs[i].processor->write_head(), std::memory_order_relaxed);
     }
+    cloudsInitialized.store(true);
+
+    // Build polyphase coefficient banks for this host rate. The output side is
+    // the exact inverse ratio of the input side, so the two never drift apart.
+    int interpolation = 1, decimation = 1;
+    PolyphaseResampler::getRationalRatio(hostSampleRate, internalSampleRate, interpolation, decimation);
+    maxHostSliceSize = std::max(1, samplesPerBlock);
+    inputResampler.prepare(interpolation, decimation, numChannels, 0);
+    auto* sidechainBus = getBus(true, 1);
+    sidechainEnabled = sidechainBus != nullptr && sidechainBus->isEnabled() && sidechainBus->getNumberOfChannels() > 0;
+    sidechainResampler.prepare(interpolation, decimation, 2, 0);
+
+    // The input FIFO holds up to one partial chunk plus one slice worth of
+    // internal samples. The output queue is primed with a chunk (plus margin
+    // for the resampler's phase, when there is one) of silence, since up to
+    // kCloudsChunkSize - 1 samples can be waiting in the input FIFO when the
+    // output side has to deliver.
+    const int maxInternalSlice = kCloudsChunkSize + inputResampler.getMaxOutputFor(maxHostSliceSize);
+    const int outputCushion = kCloudsChunkSize
+        + (inputResampler.isIdentity() ? 0 : PolyphaseResampler::kDefaultPullCushion);
+    outputResampler.prepare(decimation, interpolation, numChannels, maxInternalSlice, outputCushion);
+    inputFifoCount = 0;
+
+    // Fixed latency: input filter delay (host samples) plus output filter
+    // delay and cushion (internal samples, converted to host samples).
+    const double internalToHost = hostSampleRate / internalSampleRate;
+    resamplerLatencySamples = juce::roundToInt(
+        inputResampler.getFilterDelay()
+        + (outputResampler.getFilterDelay() + outputResampler.getPullCushion()) * internalToHost);
+    LOG_INFO("prepareToPlay: %.0f Hz, engine %.0f Hz, block %d, %d channels, resampler %d/%d, latency %d samples",
+             hostSampleRate, internalSampleRate, samplesPerBlock, numChannels, interpolation, decimation,
+             resamplerLatencySamples);
+
+    // FIFO buffers at the internal rate, and per pair one chunk of
+    // interleaved frames
+    resampledInputBuffer.setSize(numChannels + (sidechainEnabled ? 2 : 0), maxInternalSlice);
+    resampledOutputBuffer.setSize(numChannels, maxInternalSlice);
+    resampledInputBuffer.clear();
+    dryBuffer.setSize(2, samplesPerBlock);
 
-    hostSampleRate = sampleRate;
-    internalSampleRate = 32000.0;
+    previousParameters = readParameters();
+    pendingTrigger = { -1, -1 };
+    morphAmount.reset(internalSampleRate / kCloudsChunkSize, kMorphRampSeconds);
+    morphAmount.setCurrentAndTargetValue(parameterTable.get<ParamId::morph>());
 
-    // Initialize VCV-style SampleRateConverters with original Clouds FIR coefficients
-    CRASH_LOG("prepareToPlay: Initializing VCV-style SRC...");
-    inputSRC.Init(clouds::src_filter_1x_2_45);
-    outputSRC.Init(clouds::src_filter_1x_2_45);
-    CRASH_LOG("prepareToPlay: VCV-style SRC initialized");
+    inputMeter.prepare(internalSampleRate, kCloudsChunkSize);
+    qualityGovernor.prepare(hostSampleRate);
+    outputMeter.prepare(internalSampleRate, kCloudsChunkSize);
 
-    // Resize temporary buffers with safety margin
-    resampledInputBuffer.setSize(2, samplesPerBlock * 4);
-    resampledOutputBuffer.setSize(2, samplesPerBlock * 4);
-    dryBuffer.setSize(2, samplesPerBlock);
+    const int maxSliceChunks = maxInternalSlice / kCloudsChunkSize;
+    chunkParameters.resize((size_t)maxSliceChunks);
+
+    randomSeed = isNonRealtime() ? kOfflineRandomSeed
+                                 : (uint32_t)juce::Random::getSystemRandom().nextInt();
+
+    for (int i = 0; i < numChannelPairs; ++i)
+    {
+        auto& pair = channelPairs[i];
+        pair.inputFrames.resize(kCloudsChunkSize);
+        pair.recordFrames.resize(kCloudsChunkSize);
+        pair.outputFrames.resize(kCloudsChunkSize);
+        pair.shadowFrames.resize(kCloudsChunkSize);
+        pair.inputLevels.resize((size_t)maxSliceChunks);
+        pair.outputLevels.resize((size_t)maxSliceChunks);
+
+        // Set processor state before calling Prepare()
+        // (VCV Rack does this in process loop, but we do it here for simplicity)
+        pair.processor->set_playback_mode(static_cast<clouds::PlaybackMode>(currentMode.load()));
+        pair.processor->set_quality(getEngineQuality(currentQuality.load()));
+        pair.processor->set_grain_pool_size(getGrainPoolSize(currentGrainPool.load()));
+        pair.processor->set_silence(false);
+        pair.processor->Seed(randomSeed + (uint32_t)i);
+        pair.processor->Prepare();
+    }
 
-    CRASH_LOG("prepareToPlay: Resizing buffers...");
-    inputFrames.resize(samplesPerBlock * 4);
-    outputFrames.resize(samplesPerBlock * 4);
-    CRASH_LOG("prepareToPlay: Buffers resized");
+    engineLatencySamples.store(channelPairs[0].processor->spectral_latency());
+    updateLatency();
 
-    // Set processor state before calling Prepare()
-    // (VCV Rack does this in process loop, but we do it here for simplicity)
-    CRASH_LOG("prepareToPlay: Setting playback mode and quality...");
-    processor->set_playback_mode(static_cast<clouds::PlaybackMode>(currentMode.load()));
-    processor->set_quality(currentQuality.load());
-    processor->set_silence(false);
-    CRASH_LOG("prepareToPlay: About to call Prepare()...");
-    processor->Prepare();
-    CRASH_LOG("prepareToPlay: Prepare() completed - prepareToPlay DONE!");
+    if (!engineSwitchThread.isThreadRunning())
+        engineSwitchThread.startThread();
+    spectralWorker.start(samplesPerBlock, sampleRate);
+    channelPairWorkers.start(numChannelPairs - 1, samplesPerBlock, sampleRate);
+    LOG_DEBUG("prepareToPlay: done");
 }
 
 void CloudWashAudioProcessor::releaseResources()
 {
 }
 
+void CloudWashAudioProcessor::assignChannelPairs (const juce::AudioChannelSet& layout)
+{
+    using ChannelType = juce::AudioChannelSet::ChannelType;
+    static constexpr std::pair<ChannelType, ChannelType> pairs[] {
+        { juce::AudioChannelSet::left, juce::AudioChannelSet::right },
+        { juce::AudioChannelSet::centre, juce::AudioChannelSet::centre },
+        { juce::AudioChannelSet::leftSurround, juce::AudioChannelSet::rightSurround },
+        { juce::AudioChannelSet::leftSurroundSide, juce::AudioChannelSet::rightSurroundSide },
+        { juce::AudioChannelSet::leftSurroundRear, juce::AudioChannelSet::rightSurroundRear }
+    };
+
+    numBusChannels = juce::jlimit(2, PolyphaseResampler::kMaxChannels, layout.size());
+    numChannelPairs = 0;
+    for (const auto& [first, second] : pairs)
+    {
+        const int a = layout.getChannelIndexForType(first);
+        const int b = layout.getChannelIndexForType(second);
+        if (a >= 0 && b >= 0 && a < numBusChannels && b < numBusChannels && numChannelPairs < kMaxChannelPairs)
+        {
+            channelPairs[numChannelPairs].channels[0] = a;
+            channelPairs[numChannelPairs].channels[1] = b;
+            ++numChannelPairs;
+        }
+    }
+
+    // Anything else (a disabled bus, a mono one) runs as stereo
+    if (numChannelPairs == 0)
+    {
+        channelPairs[0].channels[0] = 0;
+        channelPairs[0].channels[1] = 1;
+        numChannelPairs = 1;
+    }
+
+    lfeChannel = layout.getChannelIndexForType(juce::AudioChannelSet::LFE);
+    if (lfeChannel >= numBusChannels)
+        lfeChannel = -1;
+}
+
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool CloudWashAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
@@ -210,12 +398,27 @@ bool CloudWashAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
     juce::ignoreUnused (layouts);
     return true;
   #else
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Stereo, or a surround bus the engines split into channel pairs (see
+    // assignChannelPairs()). The input must match the output.
+    const auto output = layouts.getMainOutputChannelSet();
+    if (output != juce::AudioChannelSet::stereo()
+        && output != juce::AudioChannelSet::create5point1()
+        && output != juce::AudioChannelSet::create7point1())
         return false;
 
    #if ! JucePlugin_IsSynth
-    if (layouts.getMainInputChannelSet() != juce::AudioChannelSet::stereo())
+    if (layouts.getMainInputChannelSet() != output)
         return false;
+
+    // The sidechain is optional, mono or stereo, whatever the main bus
+    if (layouts.inputBuses.size() > 1)
+    {
+        const auto sidechain = layouts.getChannelSet(true, 1);
+        if (!sidechain.isDisabled()
+            && sidechain != juce::AudioChannelSet::mono()
+            && sidechain != juce::AudioChannelSet::stereo())
+            return false;
+    }
    #endif
 
     return true;
@@ -225,155 +428,110 @@ bool CloudWashAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 
 void CloudWashAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    static int processBlockCallCount = 0;
-    if (processBlockCallCount < 5)  // Only log first 5 calls to avoid spam
-    {
-        CRASH_LOG("processBlock called #" + juce::String(++processBlockCallCount));
-    }
-
     juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
+
+    qualityGovernor.startBlock();
+    auto totalNumInputChannels  = getMainBusNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     
     // SAFETY CHECK: Ensure Clouds is initialized before processing
-    if (!cloudsInitialized.load() || processor == nullptr)
+    if (!cloudsInitialized.load() || channelPairs[0].processor == nullptr)
     {
-        CRASH_LOG("ERROR: processBlock called before Clouds initialization!");
+        LOG_RT_ERROR("processBlock called before Clouds initialization");
         buffer.clear();
         return;
     }
 
+    // The recordings change from here on (see RecordingPosition)
+    const uint32_t sequence = recordingSequence.load(std::memory_order_relaxed);
+    recordingSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    int64_t samplesProcessedInBlock = 0;
+
     // Clear unused output channels
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // METERING: Input with peak hold and decay
-    float inputMagnitude = buffer.getRMSLevel(0, 0, buffer.getNumSamples());
-    if (inputMagnitude > inputPeakHold)
-        inputPeakHold = inputMagnitude;
-    else
-        inputPeakHold *= 0.97f;  // Decay factor for smooth meter movement
-    inputPeakLevel.store(inputPeakHold);
-
     //==============================================================================
-    // 0. HANDLE MODE/QUALITY CHANGES (With silence buffer to prevent audio glitches)
+    // 0. HANDLE MODE/QUALITY CHANGES (Shadow engine prepared on the worker thread)
     //==============================================================================
 
-    auto modeParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("mode"));
-    auto qualityParam = dynamic_cast<juce::AudioParameterChoice*>(apvts.getParameter("quality"));
+    const ParameterSnapshot params = readParameters();
 
-    if (modeParam && qualityParam) {
-        int targetMode = modeParam->getIndex();
-        int targetQuality = qualityParam->getIndex();
+    {
+        int targetMode = params.mode;
+        int targetQuality = params.quality;
 
         // Quality mapping matches hardware/VCV Rack behavior
         // Internal clouds quality: 0:HiFi-Stereo, 1:HiFi-Mono, 2:LoFi-Stereo, 3:LoFi-Mono
         // Quality bits: bit 0 = mono (1) / stereo (0), bit 1 = lofi (1) / hifi (0)
+        // Index 4 (Ultra HQ) is mapped to 0 by getEngineQuality()
         int internalQuality = targetQuality;
 
-        // Check if mode or quality changed (atomic loads for thread safety)
         bool modeChanged = (targetMode != currentMode.load());
         bool qualityChanged = (internalQuality != currentQuality.load());
-
-        if (modeChanged || qualityChanged) {
-            // Use atomic compare-and-swap pattern to prevent race conditions
-            // when both mode and quality change simultaneously
-            int expected = 0;
-            if (silenceBlocksRemaining.compare_exchange_strong(expected, 4)) {
-                // Successfully started new preparation sequence
-                pendingMode.store(targetMode);
-                pendingQuality.store(internalQuality);
-            }
-            else {
-                // Already preparing - update pending values atomically
-                // This batches simultaneous changes together
-                pendingMode.store(targetMode);
-                pendingQuality.store(internalQuality);
-                // Keep existing silenceBlocksRemaining count - don't reset
-            }
-        }
-
-        // Handle silence phase before Prepare()
-        int remainingBlocks = silenceBlocksRemaining.load();
-        if (remainingBlocks > 0) {
-            if (remainingBlocks > 1) {
-                // Still silencing - output silence and decrement counter
-                silenceBlocksRemaining.store(remainingBlocks - 1);
-                buffer.clear();
-                return;
-            }
-            else {
-                // Last silence block - now safe to call Prepare() synchronously
-                // Use mutex ONLY for the critical Prepare() section to avoid blocking the audio thread
-                int newMode = pendingMode.load();
-                int newQuality = pendingQuality.load();
-
-                if (newMode >= 0 && newQuality >= 0) {
-                    // Validate mode and quality ranges before applying
-                    bool validMode = (newMode >= 0 && newMode < static_cast<int>(clouds::PLAYBACK_MODE_LAST));
-                    bool validQuality = (newQuality >= 0 && newQuality <= 3);  // Clouds internal quality: 0-3 (HiFi-S, HiFi-M, LoFi-S, LoFi-M)
-
-                    if (validMode && validQuality) {
-                        // Lock ONLY during Prepare() call - minimal critical section
-                        {
-                            std::lock_guard<std::mutex> lock(processorMutex);
-                            processor->set_playback_mode(static_cast<clouds::PlaybackMode>(newMode));
-                            processor->set_quality(newQuality);
-                            processor->Prepare();  // SAFE: Called on audio thread after silencing
-                        }
-
-                        currentMode.store(newMode);
-                        currentQuality.store(newQuality);
-                    }
-
-                    pendingMode.store(-1);
-                    pendingQuality.store(-1);
-                }
-
-                silenceBlocksRemaining.store(0);
-                buffer.clear();
-                return;
-            }
+        // The long buffer length only matters (and only reallocates) in Ultra HQ
+        bool bufferLengthChanged = (internalQuality == kUltraQualityIndex
+                                    && params.bufferSeconds != currentBufferSeconds.load());
+        // The grain pool is sized when the engine is prepared, and only
+        // matters in granular mode
+        bool grainPoolChanged = (targetMode == clouds::PLAYBACK_MODE_GRANULAR
+                                 && params.grainPool != currentGrainPool.load());
+
+        // Validate mode and quality ranges before requesting
+        bool validMode = (targetMode >= 0 && targetMode < static_cast<int>(clouds::PLAYBACK_MODE_LAST));
+        bool validQuality = (internalQuality >= 0 && internalQuality <= kUltraQualityIndex);  // 0-3 as Clouds (HiFi-S, HiFi-M, LoFi-S, LoFi-M), 4: Ultra HQ
+
+        // A recording restored by setStateInformation() comes in through a
+        // switch to an engine set up like the one it was saved from.
+        bool restoreRecording = recordingRestorePending.load(std::memory_order_acquire);
+
+        // Only one switch in flight at a time. Changes made meanwhile are
+        // picked up on the first block after the current switch completes.
+        if ((modeChanged || qualityChanged || bufferLengthChanged || grainPoolChanged || restoreRecording)
+            && validMode && validQuality
+            && engineSwitchState.load(std::memory_order_acquire) == engineSwitchIdle) {
+            requestedMode.store(targetMode);
+            requestedQuality.store(internalQuality);
+            requestedBufferSeconds.store(params.bufferSeconds);
+            requestedGrainPool.store(params.grainPool);
+            engineSwitchState.store(engineSwitchRequested, std::memory_order_release);
         }
     }
 
+    // Shadow engines ready: crossfade into them during this and following blocks.
+    crossfading = engineSwitchState.load(std::memory_order_acquire) == engineSwitchReady;
+
     //==============================================================================
     // 1. UPDATE PARAMETERS
     //==============================================================================
 
-    // Core
-    float position = apvts.getRawParameterValue("position")->load();
-    float size = apvts.getRawParameterValue("size")->load();
-    float pitch = apvts.getRawParameterValue("pitch")->load(); // -4.0 to 4.0 octaves (±48 semitones)
-    float density = apvts.getRawParameterValue("density")->load();
-    float texture = apvts.getRawParameterValue("texture")->load();
-
-    // I/O & Mix
-    float inGain = apvts.getRawParameterValue("in_gain")->load();
-    float blend = apvts.getRawParameterValue("blend")->load();
-    float spread = apvts.getRawParameterValue("spread")->load();
-    float feedback = apvts.getRawParameterValue("feedback")->load();
-    float reverb = apvts.getRawParameterValue("reverb")->load();
+    for (int i = 0; i < numChannelPairs; ++i)
+    {
+        auto* engine = channelPairs[i].processor;
+        if (params.freeze != engine->frozen())
+            engine->set_freeze(params.freeze);
+    }
 
-    auto freezeParam = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("freeze"));
-    auto triggerParam = dynamic_cast<juce::AudioParameterBool*>(apvts.getParameter("trigger"));
+    // Triggers (grain synchronization, matches VCV Rack) are placed chunk by
+    // chunk below, with the other controls.
+    const bool parameterTrigger = params.trigger && !previousParameters.trigger;
 
-    if (freezeParam) {
-        bool newFreeze = freezeParam->get();
-        if (newFreeze != processor->frozen()) processor->set_freeze(newFreeze);
-    }
-    
-    // Handle trigger parameter for grain synchronization (matches VCV Rack)
-    if (triggerParam) {
-        bool trigger = triggerParam->get();
-        clouds::Parameters* p = processor->mutable_parameters();
-        p->trigger = trigger;
-        p->gate = trigger;
-        // Reset trigger after one block so it behaves like a one-shot
-        if (trigger) {
-            triggerParam->setValueNotifyingHost(false);
-        }
+    // Offline renders get the best grain quality, switched at block edges
+    if (isNonRealtime() != renderingOffline)
+    {
+        renderingOffline = isNonRealtime();
+        LOG_RT_TRACE("Offline rendering %s: grain quality %s", renderingOffline ? "on" : "off",
+                     renderingOffline ? "maximum" : "by grain count");
     }
+    if (renderingOffline)
+        qualityGovernor.setUnlimited();
+    grainBudget = qualityGovernor.getBudget();
+
+    // Grains record from the sidechain when it is selected and connected
+    recordingSidechain = sidechainEnabled && params.recordSidechain;
+    const auto sidechainInput = getBusBuffer(buffer, true, 1);
+    const int lastSidechain = juce::jmax(0, sidechainInput.getNumChannels() - 1);
     
     // Note: Input gain is now applied during the resampling loop (around line 450)
     // VCV Rack applies gain during voltage-to-audio conversion.
@@ -382,213 +540,613 @@ void CloudWashAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
     
     // Note: No need to keep dry buffer copy - Clouds handles dry/wet internally
 
-    // Update Processor Parameters
-    clouds::Parameters* p = processor->mutable_parameters();
-    p->position = position;
-    p->size = size;
-    // Pitch: Convert octaves to semitones (multiply by 12), clamp to ±48 semitones
-    // VCV Rack: p->pitch = clamp((params[PITCH_PARAM].getValue() + inputs[PITCH_INPUT].getVoltage()) * 12.0f, -48.0f, 48.0f);
-    // Parameter range is -2.0 to 2.0 octaves, giving us ±24 semitones when multiplied by 12
-    p->pitch = juce::jlimit(-48.0f, 48.0f, pitch * 12.0f); // Convert octaves to semitones, clamped
-    p->density = density;
-    p->texture = texture;
+    // The continuous controls go to the engines chunk by chunk, in
+    // processCloudsChunk(), so ramps and the morph move within a block.
+    morphAmount.setTargetValue(params.morph);
 
-    // All blend parameters are controlled by separate knobs in the GUI
-    // No blend mode switching needed - each knob controls its respective parameter directly
-    p->dry_wet = juce::jlimit(0.0f, 1.0f, blend);
-    p->stereo_spread = spread;
-    p->feedback = feedback;
-    p->reverb = reverb;
-    
-    // Visualization data - use density as a proxy for grain activity since
-    // Clouds DSP doesn't expose active grain count publicly
-    // Density 0 = 0 grains visible, Density 1 = up to 40 grains visible
-    int estimatedGrainCount = static_cast<int>(density * 40.0f);
-    activeGrainCount.store(std::max(1, estimatedGrainCount));
-    grainDensityViz.store(density);
-    grainTextureViz.store(texture);
+    grainDensityViz.store(params.density);
+    grainTextureViz.store(params.texture);
     
     //==============================================================================
-    // 2. RESAMPLE INPUT (Host -> 32k)
+    // 2-4. RESAMPLE -> FIFO -> CLOUDS -> RESAMPLE
     //==============================================================================
 
-    int numHostSamples = buffer.getNumSamples();
-    
-    // Calculate output samples for conversion using fixed 2:1 ratio
-    // The VCV-style SRC uses polyphase FIR filtering designed for 2:1 ratios
-    // For 48k->32k, we need to handle this as a non-integer ratio
-    // The original Clouds hardware uses 32kHz internal, VCV Rack handles arbitrary ratios
-    // We use a similar approach: accumulate samples and process in chunks
-    
-    // For now, use a simplified approach: calculate expected output size
-    // based on the ratio, then use linear interpolation for non-integer ratios
-    double conversionRatio = internalSampleRate / hostSampleRate;
-    int num32kSamples = static_cast<int>(numHostSamples * conversionRatio + 0.5);
-    num32kSamples = juce::jlimit(1, resampledInputBuffer.getNumSamples(), num32kSamples);
-    
-    // Apply gain inline during resampling
-    // VCV Rack: inputFrame.samples[0] = inputs[IN_L_INPUT].getVoltage() * params[IN_GAIN_PARAM].getValue() / 5.0;
-    // Note: VST audio is ±1.0 normalized (unlike Eurorack ±5V), so no /5.0 scaling needed
-    const float* inL = buffer.getReadPointer(0);
-    const float* inR = buffer.getReadPointer(totalNumInputChannels > 1 ? 1 : 0);
-    float* outL = resampledInputBuffer.getWritePointer(0);
-    float* outR = resampledInputBuffer.getWritePointer(1);
-    
-    // Clear output buffer first
-    resampledInputBuffer.clear();
-    
-    // Simple linear resampling with gain application
-    // For 48kHz -> 32kHz, this processes samples and applies gain
-    double phase = 0.0;
-    double phaseIncrement = hostSampleRate / internalSampleRate;  // e.g., 48000/32000 = 1.5
-    
-    int outSample = 0;
-    for (int i = 0; i < numHostSamples - 1 && outSample < num32kSamples; ++i) {
-        while (phase < 1.0 && outSample < num32kSamples) {
-            float frac = static_cast<float>(phase);
-            float sampleL = inL[i] + frac * (inL[i + 1] - inL[i]);
-            float sampleR = inR[i] + frac * (inR[i + 1] - inR[i]);
-            
-            // Apply gain inline (VST: no /5.0 scaling needed)
-            outL[outSample] = sampleL * inGain;
-            outR[outSample] = sampleR * inGain;
-            
-            ++outSample;
-            phase += phaseIncrement;
+    // Host blocks of any size are handled in slices of at most the prepared
+    // block size, so nothing is ever truncated.
+    const int numHostSamples = buffer.getNumSamples();
+    const int numChannels = numBusChannels;
+    const int lastInput = juce::jmax(0, totalNumInputChannels - 1);
+    const int lastOutput = juce::jmax(0, totalNumOutputChannels - 1);
+    auto pairJob = [this](int pairIndex) { processChannelPair(pairIndex); };
+
+    for (int hostOffset = 0; hostOffset < numHostSamples; hostOffset += maxHostSliceSize)
+    {
+        const int hostSliceSize = std::min(maxHostSliceSize, numHostSamples - hostOffset);
+
+        // 2. Resample input (Host -> 32k), appended behind the partial chunk
+        // still waiting in the input FIFO. Phase and filter history carry
+        // over, so there is no drift and no discontinuity at block edges.
+        const float* hostIn[PolyphaseResampler::kMaxChannels];
+        float* fifoIn[PolyphaseResampler::kMaxChannels];
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            hostIn[ch] = buffer.getReadPointer(juce::jmin(ch, lastInput), hostOffset);
+            fifoIn[ch] = resampledInputBuffer.getWritePointer(ch, inputFifoCount);
         }
-        phase -= 1.0;
-    }
-    
-    // Fill remaining samples if any
-    while (outSample < num32kSamples) {
-        outL[outSample] = inL[numHostSamples - 1] * inGain;
-        outR[outSample] = inR[numHostSamples - 1] * inGain;
-        ++outSample;
-    }
-    
-    //============================================================================
-    // 3. PROCESS CLOUDS (Float -> Short -> Float) - CHUNKED (kMaxBlockSize=32)
-    //============================================================================
-
-    float* resampledL = resampledInputBuffer.getWritePointer(0);
-    float* resampledR = resampledInputBuffer.getWritePointer(1);
-
-    const int kMaxCloudsBlock = 32;
-    int samplesProcessed = 0;
-    static int processLogCount = 0;
-
-    // CRITICAL FIX: For spectral mode, we need to call Buffer() continuously
-    // VCV Rack calls processor->Prepare() every 32 samples, which includes phase_vocoder_.Buffer()
-    // The phase vocoder's STFT uses a hop size of fft_size / 4 (e.g., 4096/4 = 1024 samples).
-    // At 32kHz, this means Buffer() should be called approximately every 32ms, but the original
-    // hardware calls it more frequently (every 32 samples) to maintain continuous processing.
-    bool isSpectralMode = (currentMode.load() == 3); // PLAYBACK_MODE_SPECTRAL = 3
-    
-    // Track samples since last Buffer() call for spectral mode timing
-    static int samplesSinceLastBuffer = 0;
-    const int kSpectralBufferInterval = 32; // Call Buffer() every 32 samples at 32kHz (matches original hardware)
-
-    while (samplesProcessed < num32kSamples) {
-        int chunkSize = std::min(kMaxCloudsBlock, num32kSamples - samplesProcessed);
-
-        // Additional safety check: ensure we don't exceed inputFrames buffer size
-        chunkSize = std::min(chunkSize, static_cast<int>(inputFrames.size()) - samplesProcessed);
-        if (chunkSize <= 0) break;
-
-        // CRITICAL FIX: Call Buffer() for spectral mode at the correct rate
-        // The phase vocoder requires Buffer() to be called every 32 samples at 32kHz
-        // to maintain proper STFT processing timing. This matches the original hardware
-        // behavior where Prepare() (which calls Buffer()) is called every 32 samples.
-        if (isSpectralMode) {
-            samplesSinceLastBuffer += chunkSize;
-            if (samplesSinceLastBuffer >= kSpectralBufferInterval) {
-                processor->Buffer();
-                samplesSinceLastBuffer = 0;
+        const int carriedOver = inputFifoCount;
+        const int fifoSpace = resampledInputBuffer.getNumSamples() - inputFifoCount;
+        const int resampled = inputResampler.process(hostIn, hostSliceSize, fifoIn, fifoSpace);
+
+        // The sidechain runs through a resampler of its own, in step with the
+        // main input, so it lands on the same FIFO positions. It is resampled
+        // even when not recorded, to keep it in step.
+        if (sidechainEnabled)
+        {
+            const float* sidechainIn[2];
+            float* sidechainFifo[2];
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                sidechainIn[ch] = sidechainInput.getReadPointer(juce::jmin(ch, lastSidechain), hostOffset);
+                sidechainFifo[ch] = resampledInputBuffer.getWritePointer(numChannels + ch, inputFifoCount);
             }
+            const int sidechainResampled = sidechainResampler.process(sidechainIn, hostSliceSize, sidechainFifo, fifoSpace);
+            jassert(sidechainResampled == resampled);
+            juce::ignoreUnused(sidechainResampled);
         }
+        inputFifoCount += resampled;
+
+        // 3. Process Clouds in exact kMaxBlockSize chunks only, so the cost
+        // per sample does not depend on the host buffer size.
+        // The continuous controls ramp linearly from the last block's values
+        // to this one's, evaluated where each chunk ends in the host block.
+        const float hostPerInternal = (float)hostSliceSize / (float)juce::jmax(1, inputFifoCount - carriedOver);
+        numSliceChunks = inputFifoCount / kCloudsChunkSize;
+
+        // This slice's triggers, in time order: any left in the partial chunk
+        // by the last slice, the trigger parameter at the start of the block,
+        // then the note-ons, each at the FIFO position its host sample maps to.
+        std::array<NoteTrigger, kMaxSliceTriggers> triggers;
+        int numTriggers = 0;
+        auto addTrigger = [&](int position, int note)
+        {
+            if (numTriggers < kMaxSliceTriggers)
+                triggers[(size_t)numTriggers++] = { position, note };
+        };
+
+        if (pendingTrigger.position >= 0)
+            addTrigger(pendingTrigger.position, pendingTrigger.note);
+        pendingTrigger = { -1, -1 };
+
+        if (hostOffset == 0 && parameterTrigger)
+            addTrigger(carriedOver, -1);
 
-        // Convert to ShortFrame for this chunk
-        // Use safer float-to-int conversion: clamp first, then round
-        for (int i = 0; i < chunkSize; ++i)
+        for (const auto metadata : midiMessages)
         {
-            float clampedL = juce::jlimit(-32768.0f, 32767.0f, resampledL[samplesProcessed + i] * 32767.0f);
-            float clampedR = juce::jlimit(-32768.0f, 32767.0f, resampledR[samplesProcessed + i] * 32767.0f);
-            inputFrames[i].l = static_cast<int16_t>(std::round(clampedL));
-            inputFrames[i].r = static_cast<int16_t>(std::round(clampedR));
+            const auto message = metadata.getMessage();
+            const int sample = metadata.samplePosition - hostOffset;
+            // An empty FIFO (a slice too short to resample into a sample)
+            // puts it at 0, the start of the next chunk, not at -1
+            if (sample >= 0 && sample < hostSliceSize && message.isNoteOn())
+                addTrigger(juce::jlimit(0, juce::jmax(0, inputFifoCount - 1),
+                                        carriedOver + (int)((float)sample / hostPerInternal)),
+                           message.getNoteNumber());
         }
 
-        // Execute DSP
-        if (processLogCount < 3) {
-            CRASH_LOG("processBlock: About to call Process() chunk " + juce::String(samplesProcessed) + "/" + juce::String(num32kSamples));
+        int nextTrigger = 0;
+        for (int chunk = 0; chunk < numSliceChunks; ++chunk)
+        {
+            const int chunkStart = chunk * kCloudsChunkSize;
+            const float chunkEnd = (float)hostOffset
+                + (float)(chunkStart + kCloudsChunkSize - carriedOver) * hostPerInternal;
+            const float ramp = juce::jlimit(0.0f, 1.0f, chunkEnd / (float)numHostSamples);
+
+            auto& controls = chunkParameters[(size_t)chunk];
+            controls = morphParameters(rampParameters(previousParameters, params, ramp), morphAmount.getNextValue());
+            controls.trigger = false;
+            controls.triggerDelay = 0;
+
+            // Several triggers in one chunk make a single grain, on the first
+            while (nextTrigger < numTriggers && triggers[(size_t)nextTrigger].position < chunkStart + kCloudsChunkSize)
+            {
+                const auto& trigger = triggers[(size_t)nextTrigger++];
+                if (!controls.trigger)
+                {
+                    controls.trigger = true;
+                    controls.triggerDelay = trigger.position - chunkStart;
+                }
+                if (trigger.note >= 0)
+                    notePitch = (float)(trigger.note - kMiddleC);
+            }
+            controls.notePitch = notePitch;
         }
-        processor->Process(inputFrames.data(), outputFrames.data(), chunkSize);
-        if (processLogCount < 3) {
-            CRASH_LOG("processBlock: Process() completed for chunk");
-            processLogCount++;
+
+        // Triggers in the partial chunk wait for it to fill up
+        for (; nextTrigger < numTriggers; ++nextTrigger)
+        {
+            const auto& trigger = triggers[(size_t)nextTrigger];
+            if (pendingTrigger.position < 0)
+                pendingTrigger.position = trigger.position - numSliceChunks * kCloudsChunkSize;
+            if (trigger.note >= 0)
+                pendingTrigger.note = trigger.note;
         }
 
-        // Convert to Float for this chunk
-        for (int i = 0; i < chunkSize; ++i)
+        // Every channel pair through the whole slice, the first on this
+        // thread, the others on the pool when there is one
+        sliceOutputs = resampledOutputBuffer.getArrayOfWritePointers();
+        channelPairWorkers.run(numChannelPairs, pairJob);
+        const int samplesProcessed = numSliceChunks * kCloudsChunkSize;
+        samplesProcessedInBlock += samplesProcessed;
+
+        // The LFE channel takes the same path, minus the engines
+        if (lfeChannel >= 0)
+            juce::FloatVectorOperations::copy(resampledOutputBuffer.getWritePointer(lfeChannel),
+                                              resampledInputBuffer.getReadPointer(lfeChannel),
+                                              samplesProcessed);
+
+        // Meters over all channels, chunk by chunk
+        for (int chunk = 0; chunk < numSliceChunks; ++chunk)
         {
-            float sampleL = (float)outputFrames[i].l / 32768.0f;
-            float sampleR = (float)outputFrames[i].r / 32768.0f;
-            // SAFETY: Clamp output to prevent NaN/Inf
-            sampleL = juce::jlimit(-1.0f, 1.0f, sampleL);
-            sampleR = juce::jlimit(-1.0f, 1.0f, sampleR);
-            resampledOutputBuffer.setSample(0, samplesProcessed + i, sampleL);
-            resampledOutputBuffer.setSample(1, samplesProcessed + i, sampleR);
+            auto inputLevel = channelPairs[0].inputLevels[(size_t)chunk];
+            auto outputLevel = channelPairs[0].outputLevels[(size_t)chunk];
+            for (int i = 1; i < numChannelPairs; ++i)
+            {
+                inputLevel.merge(channelPairs[i].inputLevels[(size_t)chunk]);
+                outputLevel.merge(channelPairs[i].outputLevels[(size_t)chunk]);
+            }
+            inputMeter.addChunk(inputLevel, kCloudsChunkSize * numChannelPairs);
+            outputMeter.addChunk(outputLevel, kCloudsChunkSize * numChannelPairs);
         }
 
-        samplesProcessed += chunkSize;
-    }
-    
-    //==============================================================================
-    // 4. RESAMPLE OUTPUT (32k -> Host)
-    //==============================================================================
-    
-    // Linear resampling for output (32k -> host rate)
-    // Matches VCV Rack approach: simple linear interpolation for arbitrary ratios
-    const float* procL = resampledOutputBuffer.getReadPointer(0);
-    const float* procR = resampledOutputBuffer.getReadPointer(1);
-    float* finalOutL = buffer.getWritePointer(0);
-    float* finalOutR = buffer.getWritePointer(totalNumOutputChannels > 1 ? 1 : 0);
-    
-    double outPhase = 0.0;
-    double outPhaseIncrement = internalSampleRate / hostSampleRate;  // e.g., 32000/48000 = 0.666...
-    
-    for (int i = 0; i < numHostSamples; ++i) {
-        int idx = static_cast<int>(outPhase);
-        float frac = static_cast<float>(outPhase - idx);
-        
-        // Clamp index to valid range
-        if (idx >= num32kSamples - 1) {
-            idx = num32kSamples - 1;
-            frac = 0.0f;
+        if (crossfading)
+        {
+            crossfadePosition += samplesProcessed;
+            if (crossfadePosition >= kEngineCrossfadeSamples)
+            {
+                finishEngineSwitch();
+                crossfading = false;
+            }
+        }
+
+        // Move the remaining partial chunk to the front of the FIFO. It is
+        // shorter than one chunk, so the ranges never overlap.
+        const int remaining = inputFifoCount - samplesProcessed;
+        if (samplesProcessed > 0 && remaining > 0)
+        {
+            for (int ch = 0; ch < resampledInputBuffer.getNumChannels(); ++ch)
+                juce::FloatVectorOperations::copy(resampledInputBuffer.getWritePointer(ch),
+                                                  resampledInputBuffer.getReadPointer(ch, samplesProcessed),
+                                                  remaining);
         }
-        
-        float sampleL = procL[idx] + frac * (procL[idx + 1] - procL[idx]);
-        float sampleR = procR[idx] + frac * (procR[idx + 1] - procR[idx]);
-        
-        finalOutL[i] = sampleL;
-        finalOutR[i] = sampleR;
-        
-        outPhase += outPhaseIncrement;
-        if (outPhase >= num32kSamples - 1) {
-            outPhase = num32kSamples - 1;
+        inputFifoCount = remaining;
+
+        // 4. Resample output (32k -> Host). The output queue is primed with
+        // one chunk plus margin of silence, which covers the samples held back
+        // in the input FIFO: latency is fixed and it never runs dry.
+        const float* internalOut[PolyphaseResampler::kMaxChannels];
+        float* hostOut[PolyphaseResampler::kMaxChannels];
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            internalOut[ch] = resampledOutputBuffer.getReadPointer(ch);
+            hostOut[ch] = buffer.getWritePointer(juce::jmin(ch, lastOutput), hostOffset);
         }
+        outputResampler.pushInput(internalOut, samplesProcessed);
+        outputResampler.pull(hostOut, hostSliceSize);
+    }
+
+    // Where the recordings stand, for getStateInformation()
+    for (int i = 0; i < numChannelPairs; ++i)
+    {
+        auto& pair = channelPairs[i];
+        pair.recordingEngine.store(pair.processor, std::memory_order_relaxed);
+        pair.recordingHead.store(pair.processor->write_head(), std::memory_order_relaxed);
     }
+    engineSamplesProcessed.store(engineSamplesProcessed.load(std::memory_order_relaxed) + samplesProcessedInBlock,
+                                 std::memory_order_relaxed);
+    recordingSequence.store(sequence + 2, std::memory_order_release);
+
+    previousParameters = params;
+    qualityGovernor.endBlock(numHostSamples);
+    publishGrainTelemetry();
+    updateTailLength(params);
 
     // Note: Dry/wet mixing is now handled internally by the Clouds DSP
     // The blend parameter is passed to p->dry_wet above
     // No additional manual mixing needed
     
-    // METERING: Output with peak hold and decay
-    float outputMagnitude = buffer.getRMSLevel(0, 0, buffer.getNumSamples());
-    if (outputMagnitude > outputPeakHold)
-        outputPeakHold = outputMagnitude;
-    else
-        outputPeakHold *= 0.97f;  // Decay factor for smooth meter movement
-    outputPeakLevel.store(outputPeakHold);
+    // METERING: accumulated chunk by chunk in processCloudsChunk()
+    inputPeakLevel.store(inputMeter.getPeak(), std::memory_order_relaxed);
+    inputRmsLevel.store(inputMeter.getRms(), std::memory_order_relaxed);
+    outputPeakLevel.store(outputMeter.getPeak(), std::memory_order_relaxed);
+    outputRmsLevel.store(outputMeter.getRms(), std::memory_order_relaxed);
+}
+
+void CloudWashAudioProcessor::processChannelPair (int pairIndex)
+{
+    // Pool thread or audio thread: only this pair's engines and buffers, the
+    // slice's chunk controls and the channels of the FIFOs are touched here.
+    auto& pair = channelPairs[pairIndex];
+    for (int chunk = 0; chunk < numSliceChunks; ++chunk)
+        processCloudsChunk(pair, chunk);
+}
+
+void CloudWashAudioProcessor::processCloudsChunk (ChannelPair& pair, int chunk)
+{
+    const int offset = chunk * kCloudsChunkSize;
+    const bool lone = pair.channels[0] == pair.channels[1];
+    const float* inL = resampledInputBuffer.getReadPointer(pair.channels[0], offset);
+    const float* inR = resampledInputBuffer.getReadPointer(pair.channels[1], offset);
+    float* outL = sliceOutputs[pair.channels[0]] + offset;
+    float* outR = sliceOutputs[pair.channels[1]] + offset;
+
+    // Past the end of a crossfade the incoming engine already is the active
+    // one; the swap itself waits for the end of the slice.
+    const int fadePosition = crossfadePosition + offset;
+    auto* engine = pair.processor;
+    auto* incoming = crossfading ? pair.shadowProcessor : nullptr;
+    if (incoming != nullptr && fadePosition >= kEngineCrossfadeSamples)
+    {
+        engine = incoming;
+        incoming = nullptr;
+    }
+
+    const ParameterSnapshot& controls = chunkParameters[(size_t)chunk];
+    const float inGain = controls.inGain;
+    applyEngineParameters(controls, *engine->mutable_parameters());
+    engine->set_high_quality(renderingOffline);
+    engine->set_grain_budget(grainBudget);
+
+    // The incoming engine follows the same controls during the crossfade.
+    // It starts unfrozen after Prepare() reset its recording.
+    if (incoming != nullptr)
+    {
+        *incoming->mutable_parameters() = engine->parameters();
+        incoming->set_high_quality(renderingOffline);
+        incoming->set_grain_budget(grainBudget);
+    }
+
+    // Interleave into FloatFrame for this chunk, applying input gain inline
+    // VCV Rack: inputFrame.samples[0] = inputs[IN_L_INPUT].getVoltage() * params[IN_GAIN_PARAM].getValue() / 5.0;
+    // Note: VST audio is ±1.0 normalized (unlike Eurorack ±5V), so no /5.0 scaling needed
+    // The input meter rides along, two frames per step.
+    auto& inputFrames = pair.inputFrames;
+    auto& outputFrames = pair.outputFrames;
+    auto& inputLevel = pair.inputLevels[(size_t)chunk];
+    inputLevel = {};
+    for (int i = 0; i < kCloudsChunkSize; i += 2)
+    {
+        inputLevel.add(inL[i], inR[i], inL[i + 1], inR[i + 1]);
+        inputFrames[i].l = inL[i] * inGain;
+        inputFrames[i].r = inR[i] * inGain;
+        inputFrames[i + 1].l = inL[i + 1] * inGain;
+        inputFrames[i + 1].r = inR[i + 1] * inGain;
+    }
+
+    // The sidechain, when recorded, gets the same input gain; every pair
+    // records the same one.
+    const clouds::FloatFrame* recordFrames = inputFrames.data();
+    if (recordingSidechain)
+    {
+        const int sidechainChannel = resampledInputBuffer.getNumChannels() - 2;
+        const float* scL = resampledInputBuffer.getReadPointer(sidechainChannel, offset);
+        const float* scR = resampledInputBuffer.getReadPointer(sidechainChannel + 1, offset);
+        for (int i = 0; i < kCloudsChunkSize; ++i)
+        {
+            pair.recordFrames[i].l = scL[i] * inGain;
+            pair.recordFrames[i].r = scR[i] * inGain;
+        }
+        recordFrames = pair.recordFrames.data();
+    }
+
+    // Execute DSP
+    processEngine(engine, inputFrames.data(), recordFrames, outputFrames.data());
+
+    // Equal-power crossfade from the active engine into the incoming one
+    if (incoming != nullptr)
+    {
+        auto& shadowFrames = pair.shadowFrames;
+        processEngine(incoming, inputFrames.data(), recordFrames, shadowFrames.data());
+        for (int i = 0; i < kCloudsChunkSize; ++i)
+        {
+            float t = juce::jmin(1.0f, (float)(fadePosition + i) / (float)kEngineCrossfadeSamples);
+            float fadeOut = std::cos(t * juce::MathConstants<float>::halfPi);
+            float fadeIn = std::sin(t * juce::MathConstants<float>::halfPi);
+            outputFrames[i].l = outputFrames[i].l * fadeOut + shadowFrames[i].l * fadeIn;
+            outputFrames[i].r = outputFrames[i].r * fadeOut + shadowFrames[i].r * fadeIn;
+        }
+    }
+
+    // De-interleave this chunk (output is already soft-clipped to [-1, 1]),
+    // metering it on the way. A lone channel gets the average of both, so
+    // that the stereo spread folds back into it.
+    auto& outputLevel = pair.outputLevels[(size_t)chunk];
+    outputLevel = {};
+    if (lone)
+    {
+        for (int i = 0; i < kCloudsChunkSize; ++i)
+            outL[i] = 0.5f * (outputFrames[i].l + outputFrames[i].r);
+        for (int i = 0; i < kCloudsChunkSize; i += 2)
+            outputLevel.add(outL[i], outL[i], outL[i + 1], outL[i + 1]);
+        return;
+    }
+
+    for (int i = 0; i < kCloudsChunkSize; i += 2)
+    {
+        outputLevel.add(outputFrames[i].l, outputFrames[i].r, outputFrames[i + 1].l, outputFrames[i + 1].r);
+        outL[i] = outputFrames[i].l;
+        outR[i] = outputFrames[i].r;
+        outL[i + 1] = outputFrames[i + 1].l;
+        outR[i + 1] = outputFrames[i + 1].r;
+    }
+}
+
+void CloudWashAudioProcessor::processEngine (clouds::GranularProcessor* engine, const clouds::FloatFrame* input,
+                                             const clouds::FloatFrame* recordInput, clouds::FloatFrame* output)
+{
+    // Spectral frames (none in the other modes) are normally left to the
+    // worker; a frame completed by this chunk is handed over to it.
+    catchUpSpectralFrames(engine);
+    const size_t framesReady = engine->spectral_frames_ready();
+
+    engine->Process(input, recordInput, output, kCloudsChunkSize);
+
+    if (engine->spectral_frames_ready() != framesReady && !isNonRealtime())
+        spectralWorker.post(engine);
+}
+
+void CloudWashAudioProcessor::catchUpSpectralFrames (clouds::GranularProcessor* engine)
+{
+    // Offline every frame is transformed before the next chunk, as on the
+    // hardware. Realtime, a frame the worker is in the middle of stays with
+    // it: this chunk plays it late rather than wait, and the next chunk
+    // catches up if it is still pending.
+    const bool offline = isNonRealtime();
+    const size_t maxPending = offline ? 0 : engine->max_spectral_frames_pending();
+    while (engine->spectral_frames_pending() > maxPending)
+        if (!engine->Buffer() && !offline)
+            break;
+}
+
+CloudWashAudioProcessor::ParameterSnapshot CloudWashAudioProcessor::readParameters() const
+{
+    ParameterSnapshot s;
+    s.position = parameterTable.get<ParamId::position>();
+    s.size = parameterTable.get<ParamId::size>();
+    s.pitch = parameterTable.get<ParamId::pitch>();  // -2.0 to 2.0 octaves
+    s.density = parameterTable.get<ParamId::density>();
+    s.texture = parameterTable.get<ParamId::texture>();
+    s.inGain = parameterTable.get<ParamId::inGain>();
+    s.blend = parameterTable.get<ParamId::blend>();
+    s.spread = parameterTable.get<ParamId::spread>();
+    s.feedback = parameterTable.get<ParamId::feedback>();
+    s.reverb = parameterTable.get<ParamId::reverb>();
+    s.mode = parameterTable.getIndex<ParamId::mode>();
+    s.quality = parameterTable.getIndex<ParamId::quality>();
+    s.sampleMode = parameterTable.getIndex<ParamId::sampleMode>();
+    s.bufferSeconds = parameterTable.getIndex<ParamId::bufferLength>();
+    s.grainPool = parameterTable.getIndex<ParamId::grainPool>();
+    s.freeze = parameterTable.getBool<ParamId::freeze>();
+    s.trigger = parameterTable.getBool<ParamId::trigger>();
+    s.recordSidechain = parameterTable.getIndex<ParamId::recordSource>() == 1;
+    s.morph = parameterTable.get<ParamId::morph>();
+    s.morphTarget = juce::jlimit(0, kNumPresets - 1, parameterTable.getIndex<ParamId::morphTarget>());
+    s.triggerDelay = 0;
+    s.notePitch = 0.0f;
+    return s;
+}
+
+CloudWashAudioProcessor::ParameterSnapshot CloudWashAudioProcessor::rampParameters (const ParameterSnapshot& from,
+                                                                                   const ParameterSnapshot& to,
+                                                                                   float position)
+{
+    auto ramp = [position](float a, float b) { return a + (b - a) * position; };
+
+    ParameterSnapshot s = to;
+    s.position = ramp(from.position, to.position);
+    s.size = ramp(from.size, to.size);
+    s.pitch = ramp(from.pitch, to.pitch);
+    s.density = ramp(from.density, to.density);
+    s.texture = ramp(from.texture, to.texture);
+    s.inGain = ramp(from.inGain, to.inGain);
+    s.blend = ramp(from.blend, to.blend);
+    s.spread = ramp(from.spread, to.spread);
+    s.feedback = ramp(from.feedback, to.feedback);
+    s.reverb = ramp(from.reverb, to.reverb);
+    return s;
+}
+
+CloudWashAudioProcessor::ParameterSnapshot CloudWashAudioProcessor::morphParameters (const ParameterSnapshot& params,
+                                                                                    float amount) const
+{
+    if (amount <= 0.0f)
+        return params;
+
+    const auto& target = presets[(size_t)params.morphTarget].morphValues;
+    auto morph = [&](float value, ParamId id) { return value + (target[(size_t)id] - value) * amount; };
+
+    ParameterSnapshot s = params;
+    s.position = morph(params.position, ParamId::position);
+    s.size = morph(params.size, ParamId::size);
+    s.pitch = morph(params.pitch, ParamId::pitch);
+    s.density = morph(params.density, ParamId::density);
+    s.texture = morph(params.texture, ParamId::texture);
+    s.inGain = morph(params.inGain, ParamId::inGain);
+    s.blend = morph(params.blend, ParamId::blend);
+    s.spread = morph(params.spread, ParamId::spread);
+    s.feedback = morph(params.feedback, ParamId::feedback);
+    s.reverb = morph(params.reverb, ParamId::reverb);
+    return s;
+}
+
+void CloudWashAudioProcessor::applyEngineParameters (const ParameterSnapshot& params, clouds::Parameters& p)
+{
+    p.position = params.position;
+    p.size = params.size;
+    // Pitch: Convert octaves to semitones (multiply by 12), clamp to ±48 semitones
+    // VCV Rack: p->pitch = clamp((params[PITCH_PARAM].getValue() + inputs[PITCH_INPUT].getVoltage()) * 12.0f, -48.0f, 48.0f);
+    // Parameter range is -2.0 to 2.0 octaves, giving us ±24 semitones when multiplied by 12
+    // The last MIDI note stands in for the V/OCT input.
+    p.pitch = juce::jlimit(-48.0f, 48.0f, params.pitch * 12.0f + params.notePitch); // Convert octaves to semitones, clamped
+    p.density = params.density;
+    p.texture = params.texture;
+
+    // All blend parameters are controlled by separate knobs in the GUI
+    // No blend mode switching needed - each knob controls its respective parameter directly
+    p.dry_wet = juce::jlimit(0.0f, 1.0f, params.blend);
+    p.stereo_spread = params.spread;
+    p.feedback = params.feedback;
+    p.reverb = params.reverb;
+
+    p.trigger = params.trigger;
+    p.gate = params.trigger;
+    p.trigger_delay = params.triggerDelay;
+}
+
+void CloudWashAudioProcessor::publishGrainTelemetry()
+{
+    // A handful of plain stores into the private slot, then one exchange.
+    // The first channel pair stands for the others.
+    auto& t = grainTelemetry.getWriteBuffer();
+    const auto* processor = channelPairs[0].processor;
+    const bool granular = processor->playback_mode() == clouds::PLAYBACK_MODE_GRANULAR;
+    const auto& grains = processor->grain_state();
+
+    t.activeGrains = granular ? grains.num_active_grains : 0;
+    t.poolSize = granular ? grains.max_num_grains : 0;
+    for (int q = 0; q < 3; ++q)
+        t.grainsPerQuality[q] = granular ? grains.num_grains_per_quality[q] : 0;
+    t.gainNormalization = granular ? grains.gain_normalization : 1.0f;
+
+    const int bufferSize = processor->recording_buffer_size();
+    t.writeHead = bufferSize > 0 ? (float)processor->write_head() / (float)bufferSize : 0.0f;
+    t.grainBudget = qualityGovernor.getBudget();
+    t.cpuLoad = qualityGovernor.getLoad();
+
+    grainTelemetry.publish();
+}
+
+void CloudWashAudioProcessor::updateTailLength (const ParameterSnapshot& params)
+{
+    // Frozen, the recording plays for as long as it stays frozen. Otherwise
+    // the engine sleeps sleep_delay() after its output goes quiet, which is
+    // once the reverb has died down. Feedback sends the recording round
+    // again: the passes it takes to fade out are counted as kMaxTailPasses,
+    // and the reverb in whole seconds, so that the host is not told about
+    // every move of a knob.
+    double tail = std::numeric_limits<double>::infinity();
+    if (!params.freeze)
+    {
+        const auto* engine = channelPairs[0].processor;
+        const double passes = params.feedback >= 0.01f ? kMaxTailPasses : 1.0;
+        tail = passes * engine->sleep_delay() / internalSampleRate
+               + std::ceil(engine->reverb_decay_time());
+    }
+
+    if (tail != tailLengthSeconds.load(std::memory_order_relaxed))
+    {
+        tailLengthSeconds.store(tail, std::memory_order_relaxed);
+        tailLengthChanged.store(true, std::memory_order_relaxed);
+    }
+}
+
+//==============================================================================
+// MODE/QUALITY SWITCHING
+//==============================================================================
+
+void CloudWashAudioProcessor::EngineSwitchThread::run()
+{
+    while (!threadShouldExit())
+    {
+        // Polling keeps the audio thread free of any locks or signalling.
+        wait(5);
+        owner.prepareShadowEngine();
+    }
+}
+
+void CloudWashAudioProcessor::prepareShadowEngine()
+{
+    if (engineSwitchState.load(std::memory_order_acquire) != engineSwitchRequested)
+        return;
+
+    std::lock_guard<std::mutex> lock(processorMutex);
+
+    // prepareToPlay() may have cancelled the request while we waited.
+    if (engineSwitchState.load(std::memory_order_acquire) != engineSwitchRequested)
+        return;
+
+    // The shadow engines are idle: the audio thread only touches them once
+    // they are published below. Re-initialize from scratch; their buffers
+    // hold stale audio from the last time they were active.
+    const int quality = requestedQuality.load();
+    const int longBufferSeconds = quality == kUltraQualityIndex ? requestedBufferSeconds.load() : 0;
+    for (int i = 0; i < numChannelPairs; ++i)
+    {
+        auto* shadow = channelPairs[i].shadowProcessor;
+
+        // Ultra HQ runs on heap-sized memory; (re)allocating it here keeps
+        // allocation off the audio thread.
+        auto& slot = getEngineSlot(shadow);
+        if (slot.longBufferSeconds != longBufferSeconds || slot.sampleRate != internalSampleRate)
+            initialiseEngineSlot(slot, longBufferSeconds);
+
+        shadow->set_playback_mode(static_cast<clouds::PlaybackMode>(requestedMode.load()));
+        shadow->set_quality(getEngineQuality(quality));
+        shadow->set_grain_pool_size(getGrainPoolSize(requestedGrainPool.load()));
+        shadow->set_silence(false);
+        shadow->set_freeze(false);
+        shadow->Seed(randomSeed + (uint32_t)i);
+        shadow->ResetBuffers();
+        shadow->Prepare();
+    }
+
+    // A restored recording is loaded only into engines with the same memory
+    // layout as the ones it was saved from, each pair's into its own;
+    // otherwise it is dropped. Either way it is consumed by this switch.
+    if (pendingRecording != nullptr)
+    {
+        const auto& recording = *pendingRecording;
+        const bool matches = recording.mode == requestedMode.load()
+                             && recording.quality == quality
+                             && recording.bufferSeconds == longBufferSeconds
+                             && recording.sampleRate == getEngineSlot(channelPairs[0].shadowProcessor).sampleRate;
+
+        if (!matches)
+            LOG_INFO("State: saved recording does not fit this engine, dropped");
+
+        for (int i = 0; matches && i < numChannelPairs; ++i)
+        {
+            const auto& image = recording.images[(size_t)i];
+            if (!image.empty() && channelPairs[i].shadowProcessor->LoadPersistentData(image.data()))
+                LOG_INFO("State: recording restored for channel pair %d (%d bytes)",
+                         i + 1, (int)(image.size() * sizeof(uint32_t)));
+        }
+
+        pendingRecording.reset();
+        recordingRestorePending.store(false, std::memory_order_release);
+    }
+
+    engineSwitchState.store(engineSwitchReady, std::memory_order_release);
+}
+
+void CloudWashAudioProcessor::finishEngineSwitch()
+{
+    for (int i = 0; i < numChannelPairs; ++i)
+        std::swap(channelPairs[i].processor, channelPairs[i].shadowProcessor);
+    crossfadePosition = 0;
+
+    currentMode.store(requestedMode.load());
+    currentQuality.store(requestedQuality.load());
+    currentBufferSeconds.store(requestedBufferSeconds.load());
+    currentGrainPool.store(requestedGrainPool.load());
+    engineSwitchState.store(engineSwitchIdle, std::memory_order_release);
+
+    // Spectral mode adds a hop of latency; the host hears about it from
+    // the message thread.
+    const int latency = channelPairs[0].processor->spectral_latency();
+    if (latency != engineLatencySamples.load(std::memory_order_relaxed))
+    {
+        engineLatencySamples.store(latency, std::memory_order_relaxed);
+        latencyChanged.store(true, std::memory_order_release);
+    }
 }
 
 juce::String CloudWashAudioProcessor::getQualityModeName(int index)
@@ -603,12 +1161,72 @@ juce::String CloudWashAudioProcessor::getQualityModeName(int index)
     }
 }
 
+int CloudWashAudioProcessor::getEngineQuality(int qualityIndex)
+{
+    // Ultra HQ is Hi-Fi Stereo on a long buffer
+    return qualityIndex == kUltraQualityIndex ? 0 : qualityIndex;
+}
+
+int CloudWashAudioProcessor::getGrainPoolSize(int index)
+{
+    return grainPoolSizes[(size_t)juce::jlimit(0, (int)grainPoolSizes.size() - 1, index)];
+}
+
+double CloudWashAudioProcessor::getEngineSampleRate (double hostRate) const
+{
+    const bool native = parameterTable.getIndex<ParamId::engineRate>() == 1;
+    if (native && hostRate >= kHardwareSampleRate && hostRate <= kMaxNativeSampleRate)
+        return hostRate;
+    return kHardwareSampleRate;
+}
+
+void CloudWashAudioProcessor::parameterChanged (const juce::String&, float)
+{
+    // May be called from the audio thread (automation)
+    engineRateChanged.store(true, std::memory_order_release);
+}
+
+void CloudWashAudioProcessor::updateLatency()
+{
+    const double internalToHost = hostSampleRate / internalSampleRate;
+    const int latency = resamplerLatencySamples
+        + juce::roundToInt(engineLatencySamples.load(std::memory_order_relaxed) * internalToHost);
+
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+}
+
+void CloudWashAudioProcessor::timerCallback()
+{
+    // JUCE has no tail change of its own: hosts query the tail again along
+    // with the latency
+    if (tailLengthChanged.exchange(false, std::memory_order_relaxed))
+        updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withLatencyChanged(true));
+
+    const bool latencyUpdate = latencyChanged.exchange(false, std::memory_order_acquire);
+    const bool rateUpdate = engineRateChanged.exchange(false, std::memory_order_acquire);
+    if (!latencyUpdate && !rateUpdate)
+        return;
+
+    // Not prepared yet: the next prepareToPlay() picks the rate up.
+    if (!cloudsInitialized.load() || getSampleRate() <= 0.0)
+        return;
+
+    if (latencyUpdate)
+        updateLatency();
+
+    // A new engine rate re-sizes the engines, which is the host's
+    // prepareToPlay() to do. The latency changes with it: hosts restart
+    // processing when told so, the others apply it the next time they
+    // prepare.
+    if (rateUpdate && getEngineSampleRate(getSampleRate()) != internalSampleRate)
+        updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withLatencyChanged(true));
+}
+
 //==============================================================================
 juce::AudioProcessorEditor* CloudWashAudioProcessor::createEditor()
 {
-    CRASH_LOG("createEditor: About to create CloudWashAudioProcessorEditor...");
     auto* editor = new CloudWashAudioProcessorEditor (*this);
-    CRASH_LOG("createEditor: Editor created successfully!");
     return editor;
 }
 
@@ -618,15 +1236,228 @@ bool CloudWashAudioProcessor::hasEditor() const
 }
 
 //==============================================================================
+namespace
+{
+    // Binary state: magic, version, then chunks of (tag, payload size,
+    // payload), all little-endian. Unknown chunks are skipped.
+    //   parm  count, then (id length, id, normalised value) per parameter
+    //   engn  mode, quality index, long buffer seconds, engine rate (Hz)
+    //   pair  channel pair index of the stat and buff chunks that follow
+    //         (version 2; version 1 states have the first pair's only)
+    //   stat  clouds::PersistentState
+    //   buff  encoding, raw size, encoded recording; one per channel
+    constexpr uint32_t kStateMagic = stmlib::FourCC<'C', 'W', 's', 't'>::value;
+    constexpr int kStateVersion = 2;
+
+    constexpr uint32_t kChunkParameters = stmlib::FourCC<'p', 'a', 'r', 'm'>::value;
+    constexpr uint32_t kChunkEngine = stmlib::FourCC<'e', 'n', 'g', 'n'>::value;
+    constexpr uint32_t kChunkPair = stmlib::FourCC<'p', 'a', 'i', 'r'>::value;
+    constexpr uint32_t kChunkState = stmlib::FourCC<'s', 't', 'a', 't'>::value;
+    constexpr uint32_t kChunkBuffer = stmlib::FourCC<'b', 'u', 'f', 'f'>::value;
+
+    constexpr size_t kBufferChunkHeaderSize = 5;  // Encoding byte, raw size
+
+    // No engine records more than this per channel: a longest long buffer,
+    // 16-bit at the highest engine rate. Bigger raw sizes are corrupt.
+    constexpr size_t kMaxRecordingBytes = (size_t)CloudWashAudioProcessor::kMaxLongBufferSeconds
+        * (size_t)CloudWashAudioProcessor::kMaxNativeSampleRate * sizeof(int16_t);
+
+    void writeChunk (juce::MemoryOutputStream& out, uint32_t tag, const void* data, size_t size)
+    {
+        out.writeInt((int)tag);
+        out.writeInt((int)size);
+        out.write(data, size);
+    }
+}
+
 void CloudWashAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    auto state = apvts.copyState();
-    std::unique_ptr<juce::XmlElement> xml (state.createXml());
-    copyXmlToBinary (*xml, destData);
+    juce::MemoryOutputStream out (destData, false);
+    out.writeInt((int)kStateMagic);
+    out.writeInt(kStateVersion);
+
+    juce::MemoryOutputStream parameterChunk;
+    parameterChunk.writeInt((int)numParameters);
+    for (size_t i = 0; i < numParameters; ++i)
+    {
+        const auto idLength = std::strlen(parameterIds[i]);
+        parameterChunk.writeByte((char)idLength);
+        parameterChunk.write(parameterIds[i], idLength);
+        parameterChunk.writeFloat(parameterTable.getParameter(i)->getValue());
+    }
+    writeChunk(out, kChunkParameters, parameterChunk.getData(), parameterChunk.getDataSize());
+
+    // Copy each pair's active engine recording (see RecordingPosition)
+    // under the lock, which keeps the worker and prepareToPlay() off the
+    // engines, and compress them outside. The audio thread keeps recording
+    // meanwhile, as on the hardware.
+    int engineSetup[4] {};
+    std::array<RecordingSnapshot, kMaxChannelPairs> snapshots;
+    int numSnapshots = 0;
+    bool copied = false;
+    bool sixteenBit = false;
+    {
+        std::lock_guard<std::mutex> lock(processorMutex);
+        if (!cloudsInitialized.load())
+            return;
+
+        // An engine switch finishing during the copy makes it stale: size
+        // them again for the new engines, a few times at most. The pairs
+        // switch together, so once the first pair's engine is still the one
+        // copied at the end, all of them are from the same switch.
+        const auto& firstPair = channelPairs[0];
+        numSnapshots = numChannelPairs;
+        for (int attempt = 0; attempt < 3 && !copied; ++attempt)
+        {
+            auto* engine = firstPair.recordingEngine.load(std::memory_order_acquire);
+            if (engine == nullptr)
+                return;
+
+            const auto& slot = getEngineSlot(engine);
+            engineSetup[0] = engine->playback_mode();
+            engineSetup[1] = slot.longBufferSeconds > 0 ? kUltraQualityIndex : engine->quality();
+            engineSetup[2] = slot.longBufferSeconds;
+            engineSetup[3] = juce::roundToInt(slot.sampleRate);
+            sixteenBit = (engine->quality() & 2) == 0 && engine->playback_mode() != clouds::PLAYBACK_MODE_SPECTRAL;
+
+            snapshots[0].engine = engine;
+            copied = copyRecording(firstPair, snapshots[0]);
+            for (int i = 1; i < numSnapshots && copied; ++i)
+            {
+                snapshots[(size_t)i].engine = channelPairs[i].recordingEngine.load(std::memory_order_acquire);
+                copied = snapshots[(size_t)i].engine != nullptr
+                         && copyRecording(channelPairs[i], snapshots[(size_t)i]);
+            }
+            copied = copied && firstPair.recordingEngine.load(std::memory_order_acquire) == engine;
+        }
+
+        // Without a copy, the parameters and engine setup are saved alone
+        if (!copied)
+        {
+            LOG_ERROR("getStateInformation: the recording kept changing, saved without it");
+            numSnapshots = 0;
+        }
+    }
+    juce::MemoryOutputStream engineChunk;
+    for (int value : engineSetup)
+        engineChunk.writeInt(value);
+    writeChunk(out, kChunkEngine, engineChunk.getData(), engineChunk.getDataSize());
+
+    std::vector<uint8_t> encoded;
+    for (int i = 0; i < numSnapshots; ++i)
+    {
+        const auto& snapshot = snapshots[(size_t)i];
+        const auto pairIndex = juce::ByteOrder::swapIfBigEndian((uint32_t)i);
+        writeChunk(out, kChunkPair, &pairIndex, sizeof(pairIndex));
+        writeChunk(out, kChunkState, &snapshot.state, sizeof(snapshot.state));
+
+        for (const auto& channel : snapshot.buffers)
+        {
+            encoded.assign(kBufferChunkHeaderSize, 0);
+            const auto encoding = RecordingCodec::encode(channel.data(), channel.size(), sixteenBit, encoded);
+            encoded[0] = encoding;
+            const auto rawSize = juce::ByteOrder::swapIfBigEndian((uint32_t)channel.size());
+            std::memcpy(encoded.data() + 1, &rawSize, sizeof(rawSize));
+            writeChunk(out, kChunkBuffer, encoded.data(), encoded.size());
+        }
+    }
+}
+
+CloudWashAudioProcessor::RecordingPosition CloudWashAudioProcessor::readRecordingPosition (const ChannelPair& pair) const
+{
+    RecordingPosition position;
+    position.sequence = recordingSequence.load(std::memory_order_acquire);
+    position.engine = pair.recordingEngine.load(std::memory_order_relaxed);
+    position.head = pair.recordingHead.load(std::memory_order_relaxed);
+    position.samplesProcessed = engineSamplesProcessed.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // A block started or ended while reading: as good as running
+    if (recordingSequence.load(std::memory_order_relaxed) != position.sequence)
+        position.sequence |= 1;
+    return position;
+}
+
+bool CloudWashAudioProcessor::copyRecording (const ChannelPair& pair, RecordingSnapshot& snapshot)
+{
+    // Only the block pointers and sizes are read here; they stay put until
+    // the engine is prepared again, which takes processorMutex.
+    auto* engine = snapshot.engine;
+    clouds::PersistentBlock blocks[4];
+    size_t numBlocks = 0;
+    engine->GetPersistentData(blocks, &numBlocks);
+    snapshot.buffers.resize(numBlocks - 1);
+    for (size_t i = 1; i < numBlocks; ++i)
+        snapshot.buffers[i - 1].resize(blocks[i].size);
+
+    // The record head moves at most a sample per engine sample. The spectral
+    // mode's frames change everywhere, on the audio thread and the worker.
+    const bool spectral = engine->playback_mode() == clouds::PLAYBACK_MODE_SPECTRAL;
+    const int64_t recordingSize = engine->recording_buffer_size();
+    const size_t bytesPerSample = (engine->quality() & 2) ? 1 : 2;
+
+    auto copyBytes = [&](size_t offset, size_t size)
+    {
+        for (size_t i = 1; i < numBlocks; ++i)
+            std::memcpy(snapshot.buffers[i - 1].data() + offset,
+                        static_cast<const uint8_t*>(blocks[i].data) + offset, size);
+    };
+
+    RecordingPosition previous;
+    bool copiedOnce = false;
+    for (int pass = 0; pass < kMaxSnapshotPasses; ++pass)
+    {
+        const auto start = readRecordingPosition(pair);
+        if (start.engine != engine)
+            return false;
+
+        // A block is running, or the worker is still transforming its frames
+        if ((start.sequence & 1) != 0 || !spectralWorker.isIdle())
+        {
+            juce::Thread::sleep(1);
+            continue;
+        }
+
+        // All of it the first time. Then only what was recorded since the
+        // last pass started, from its record head on, and the interpolation
+        // tail that mirrors the start of the buffer.
+        const int64_t recorded = start.samplesProcessed - previous.samplesProcessed;
+        if (!copiedOnce || spectral || recorded >= recordingSize)
+        {
+            copyBytes(0, blocks[1].size);
+        }
+        else if (recorded > 0)
+        {
+            const int64_t first = std::min(recorded, recordingSize - previous.head);
+            copyBytes((size_t)previous.head * bytesPerSample, (size_t)first * bytesPerSample);
+            copyBytes(0, (size_t)(recorded - first) * bytesPerSample);
+            const size_t tail = (size_t)recordingSize * bytesPerSample;
+            copyBytes(tail, blocks[1].size - tail);
+        }
+        copiedOnce = true;
+        previous = start;
+
+        // No block in between: this is the recording as of start
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (recordingSequence.load(std::memory_order_relaxed) == start.sequence)
+        {
+            snapshot.state.write_head[0] = snapshot.state.write_head[1] = start.head;
+            snapshot.state.quality = (uint8_t)engine->quality();
+            snapshot.state.spectral = spectral;
+            return true;
+        }
+    }
+
+    snapshot.buffers.clear();
+    return false;
 }
 
 void CloudWashAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
+    if (readBinaryState(data, sizeInBytes))
+        return;
+
+    // States saved before the binary format: APVTS XML, parameters only
     std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
 
     if (xmlState.get() != nullptr)
@@ -634,7 +1465,162 @@ void CloudWashAudioProcessor::setStateInformation (const void* data, int sizeInB
             apvts.replaceState (juce::ValueTree::fromXml (*xmlState));
 }
 
+bool CloudWashAudioProcessor::readBinaryState (const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream in (data, (size_t)juce::jmax(0, sizeInBytes), false);
+    if (sizeInBytes < 8 || (uint32_t)in.readInt() != kStateMagic)
+        return false;
+    in.readInt();  // Version; version 1 is version 2 without pair chunks
+
+    // The recordings are decompressed here, on the caller's thread, straight
+    // into the images LoadPersistentData() reads. Chunks before any pair
+    // chunk belong to the first pair.
+    auto recording = std::make_unique<SavedRecording>();
+    bool hasEngine = false;
+    bool hasState[kMaxChannelPairs] {};
+    int numBuffers[kMaxChannelPairs] {}, expectedBuffers[kMaxChannelPairs] {};
+    int pairIndex = 0;
+
+    while (in.getNumBytesRemaining() >= 8)
+    {
+        const auto tag = (uint32_t)in.readInt();
+        const auto size = (size_t)(uint32_t)in.readInt();
+        const auto start = in.getPosition();
+        if ((juce::int64)size > in.getNumBytesRemaining())
+            break;
+
+        const auto* payload = static_cast<const uint8_t*>(data) + start;
+        juce::MemoryInputStream chunk (payload, size, false);
+
+        if (tag == kChunkParameters)
+        {
+            const int count = chunk.readInt();
+            for (int i = 0; i < count && !chunk.isExhausted(); ++i)
+            {
+                char id[256] {};
+                const int idLength = (uint8_t)chunk.readByte();
+                chunk.read(id, idLength);
+                const float value = chunk.readFloat();
+
+                for (size_t p = 0; p < numParameters; ++p)
+                    if (std::strcmp(id, parameterIds[p]) == 0)
+                        parameterTable.getParameter(p)->setValueNotifyingHost(juce::jlimit(0.0f, 1.0f, value));
+            }
+        }
+        else if (tag == kChunkEngine && size >= 4 * sizeof(int))
+        {
+            recording->mode = chunk.readInt();
+            recording->quality = chunk.readInt();
+            recording->bufferSeconds = chunk.readInt();
+            recording->sampleRate = chunk.readInt();
+            hasEngine = true;
+        }
+        else if (tag == kChunkPair && size >= sizeof(uint32_t))
+        {
+            // Out of range: the chunks that follow are skipped
+            const auto index = (uint32_t)chunk.readInt();
+            pairIndex = index < (uint32_t)kMaxChannelPairs ? (int)index : -1;
+        }
+        else if (tag == kChunkState && pairIndex >= 0 && size == sizeof(clouds::PersistentState) && !hasState[pairIndex])
+        {
+            clouds::PersistentState persistentState;
+            std::memcpy(&persistentState, payload, sizeof(persistentState));
+            expectedBuffers[pairIndex] = (persistentState.quality & 1) ? 1 : 2;
+
+            auto& image = recording->images[(size_t)pairIndex];
+            image.push_back(tag);
+            image.push_back((uint32_t)size);
+            image.resize(image.size() + size / sizeof(uint32_t));
+            std::memcpy(image.data() + image.size() - size / sizeof(uint32_t), payload, size);
+            hasState[pairIndex] = true;
+        }
+        else if (tag == kChunkBuffer && pairIndex >= 0 && hasState[pairIndex] && size >= kBufferChunkHeaderSize)
+        {
+            uint32_t rawSize;
+            std::memcpy(&rawSize, payload + 1, sizeof(rawSize));
+            rawSize = juce::ByteOrder::swapIfBigEndian(rawSize);
+            if (rawSize % sizeof(uint32_t) != 0 || rawSize > kMaxRecordingBytes)
+            {
+                LOG_INFO("State: corrupt recording, ignored");
+                return true;
+            }
+
+            auto& image = recording->images[(size_t)pairIndex];
+            const size_t offset = image.size() + 2;
+            image.push_back(tag);
+            image.push_back(rawSize);
+            image.resize(offset + rawSize / sizeof(uint32_t));
+            if (!RecordingCodec::decode((RecordingCodec::Encoding)payload[0],
+                                        payload + kBufferChunkHeaderSize, size - kBufferChunkHeaderSize,
+                                        image.data() + offset, rawSize))
+            {
+                LOG_INFO("State: corrupt recording, ignored");
+                return true;
+            }
+            ++numBuffers[pairIndex];
+        }
+
+        in.setPosition(start + (juce::int64)size);
+    }
+
+    // A pair missing some of its chunks starts empty
+    for (int i = 0; i < kMaxChannelPairs; ++i)
+        if (!hasState[i] || numBuffers[i] != expectedBuffers[i])
+            recording->images[(size_t)i].clear();
+
+    // Parameters are in place by now, so the switch this triggers brings up
+    // an engine matching the recording.
+    if (hasEngine && !recording->images[0].empty())
+    {
+        std::unique_ptr<SavedRecording> previous;
+        {
+            std::lock_guard<std::mutex> lock(processorMutex);
+            previous = std::move(pendingRecording);
+            pendingRecording = std::move(recording);
+            recordingRestorePending.store(true, std::memory_order_release);
+        }
+    }
+
+    return true;
+}
+
 //==============================================================================
+namespace
+{
+    // Normalised values, in the order of CloudWashAudioProcessor::presetParameters.
+    // Choice values are normalised over the number of choices and rounded to
+    // the nearest one: quality has five, so 0.2 = Hi-Fi Mono, 0.6 = Lo-Fi Mono.
+    struct FactoryPreset
+    {
+        const char* name;
+        float values[CloudWashAudioProcessor::numPresetParameters];
+    };
+
+    constexpr FactoryPreset factoryPresets[CloudWashAudioProcessor::kNumPresets] {
+        //                              posit.   size  pitch  dens.  text.   gain  blend spread  fdbk.  verb.   mode  qual. freeze smode
+        { "01 - Init",             {   0.5f,   0.5f,   0.0f,   0.5f,   0.5f,   0.8f,   0.5f,   0.0f,   0.0f,   0.0f,   0.0f,   0.0f,   0.0f,   0.0f } },
+        { "02 - Ethereal Cloud",   {   0.7f,   0.8f, 0.505f,  0.65f,   0.4f,   0.8f,   0.7f,   0.9f,   0.3f,   0.6f,   0.0f,   0.6f,   0.0f,   0.0f } },
+        { "03 - Grain Storm",      {   0.2f,   0.3f, 0.375f,   0.9f,   0.8f,   0.9f,   0.8f,   0.4f,   0.1f,   0.2f,   0.0f,   0.6f,   0.0f,   0.0f } },
+        { "04 - Spectral Wash",    {   0.5f,   0.6f,   0.5f,   0.7f,   0.3f,   0.7f,   1.0f,   0.6f,   0.0f,   0.5f,   1.0f,   0.0f,   0.0f,   0.0f } },
+        { "05 - Lo-Fi Dream",      {   0.4f,   0.5f,  0.45f,   0.4f,   0.9f,   0.8f,   0.6f,   0.2f,   0.4f,   0.3f,   0.0f,   0.6f,   0.0f,   0.0f } },
+        { "06 - Frozen Moment",    {   0.5f,   0.7f,   0.5f,   0.3f,   0.5f,   0.8f,   0.9f,   0.5f,   0.5f,   0.7f,   0.0f,   0.0f,   1.0f,   0.0f } },
+        { "07 - Reverse Echo",     {   0.3f,   0.6f,   0.5f,   0.6f,   0.4f,   0.8f,   0.7f,   0.3f,   0.6f,   0.4f,   0.0f,   0.2f,   0.0f,   1.0f } },
+        { "08 - Shimmer Verb",     {   0.8f,   0.9f,  0.75f,   0.5f,   0.2f,   0.7f,   0.6f,   1.0f,   0.2f,   0.9f,   0.0f,   0.0f,   0.0f,   0.0f } },
+        { "09 - Glitch Machine",   {   0.1f,   0.1f,   0.4f,  0.95f,   1.0f,   1.0f,   0.9f,   0.1f,   0.0f,   0.1f,   0.0f,   0.6f,   0.0f,   0.0f } },
+        { "10 - Pitch Shifter",    {   0.5f,   0.4f, 0.625f,   0.5f,   0.5f,   0.8f,   1.0f,   0.0f,   0.0f,   0.0f,  0.33f,   0.0f,   0.0f,   0.0f } },
+        { "11 - Looping Delay",    {   0.5f,   0.5f,   0.5f,   0.6f,   0.5f,   0.8f,   0.5f,   0.5f,   0.7f,   0.3f,  0.67f,   0.2f,   0.0f,   0.0f } },
+        { "12 - Ambient Pad",      {   0.6f,  0.85f,   0.5f,  0.45f,   0.3f,   0.7f,   0.8f,   0.8f,   0.4f,   0.8f,   0.0f,   0.0f,   0.0f,   0.0f } },
+        { "13 - Octave Up",        {   0.5f,   0.3f,  0.75f,   0.5f,   0.5f,   0.8f,   0.8f,   0.0f,   0.0f,   0.1f,  0.33f,   0.0f,   0.0f,   0.0f } },
+        { "14 - Octave Down",      {   0.5f,   0.3f,  0.25f,   0.5f,   0.5f,   0.8f,   0.8f,   0.0f,   0.0f,   0.1f,  0.33f,   0.0f,   0.0f,   0.0f } },
+        { "15 - Spectral Freeze",  {   0.5f,   0.5f,   0.5f,   0.8f,   0.6f,   0.7f,   1.0f,   0.7f,   0.0f,   0.6f,   1.0f,   0.0f,   1.0f,   0.0f } },
+        { "16 - Dense Texture",    {   0.4f,   0.4f,  0.48f,  0.85f,  0.75f,  0.85f,  0.75f,   0.6f,   0.3f,   0.4f,   0.0f,   0.2f,   0.0f,   0.0f } },
+        { "17 - Sparse Grains",    {   0.6f,   0.8f,   0.5f,   0.2f,   0.6f,   0.8f,  0.65f,   0.5f,   0.2f,   0.5f,   0.0f,   0.0f,   0.0f,   0.0f } },
+        { "18 - Pitch Cascade",    {   0.3f,   0.5f,  0.35f,   0.7f,   0.5f,   0.8f,   0.7f,   0.4f,   0.8f,   0.5f,  0.67f,   0.2f,   0.0f,   0.0f } },
+        { "19 - Resonant Delay",   {   0.5f,   0.6f,   0.5f,   0.6f,   0.4f,   0.8f,   0.6f,   0.3f,   0.9f,   0.2f,  0.67f,   0.0f,   0.0f,   0.0f } },
+        { "20 - Granular Chaos",   {  0.15f,   0.2f,  0.55f,   1.0f,  0.95f,   0.9f,  0.85f,   0.7f,   0.5f,   0.3f,   0.0f,   0.6f,   0.0f,   0.0f } },
+    };
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout CloudWashAudioProcessor::createParameterLayout()
 {
     juce::AudioProcessorValueTreeState::ParameterLayout layout;
@@ -704,13 +1690,50 @@ juce::AudioProcessorValueTreeState::ParameterLayout CloudWashAudioProcessor::cre
             "Hi-Fi Stereo (1s)", 
             "Hi-Fi Mono (2s)", 
             "Lo-Fi Stereo (4s)", 
-            "Lo-Fi Mono (8s)"
+            "Lo-Fi Mono (8s)",
+            "Ultra HQ (Long Buffer)"
         }, 0));
 
     layout.add(std::make_unique<juce::AudioParameterChoice>(
         "sample_mode", "Sample Mode",
         juce::StringArray{"Normal", "Reverse"}, 0));
 
+    // Recording length of the Ultra HQ quality, in seconds of stereo
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+        "buffer_length", "Long Buffer Length",
+        kMinLongBufferSeconds, kMaxLongBufferSeconds, 20));
+
+    // 32kHz with resampling, like the hardware, or the host rate directly
+    // (no resampling cost or latency; delays, grains and filters are scaled).
+    // Takes effect when the host next prepares the plugin.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        "engine_rate", "Engine Rate",
+        juce::StringArray{"32 kHz (Hardware)", "Host Rate"}, 0));
+
+    // Morph from the current controls toward a preset (continuous controls
+    // only; mode, quality and the switches stay put)
+    layout.add(std::make_unique<juce::AudioParameterFloat>(
+        "morph", "Morph",
+        juce::NormalisableRange<float>(0.0f, 1.0f, 0.001f), 0.0f));
+
+    juce::StringArray presetNames;
+    for (const auto& preset : factoryPresets)
+        presetNames.add(preset.name);
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        "morph_target", "Morph Target", presetNames, 0));
+
+    // What the grains are recorded from. The sidechain is used only while
+    // the host has it connected; the main input always stays on the dry path.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        "record_source", "Record Source",
+        juce::StringArray{"Input", "Sidechain"}, 0));
+
+    // Grains the granular mode can play at once. Density spreads over the
+    // whole pool; a change crossfades to a freshly prepared engine.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        "grain_pool", "Grain Pool",
+        juce::StringArray{"Hardware", "128 Grains", "256 Grains", "512 Grains"}, 0));
+
     return layout;
 }
 
@@ -720,184 +1743,46 @@ juce::AudioProcessorValueTreeState::ParameterLayout CloudWashAudioProcessor::cre
 
 void CloudWashAudioProcessor::initializePresets()
 {
-    presets.clear();
-
-    // Preset 1: Init (Default)
-    presets.push_back({"01 - Init", {
-        {"position", 0.5f}, {"size", 0.5f}, {"pitch", 0.0f}, {"density", 0.5f}, {"texture", 0.5f},
-        {"in_gain", 0.8f}, {"blend", 0.5f}, {"spread", 0.0f}, {"feedback", 0.0f}, {"reverb", 0.0f},
-        {"mode", 0.0f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 2: Ethereal Cloud
-    presets.push_back({"02 - Ethereal Cloud", {
-        {"position", 0.7f}, {"size", 0.8f}, {"pitch", 0.505f}, {"density", 0.65f}, {"texture", 0.4f},
-        {"in_gain", 0.8f}, {"blend", 0.7f}, {"spread", 0.9f}, {"feedback", 0.3f}, {"reverb", 0.6f},
-        {"mode", 0.0f}, {"quality", 1.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 3: Grain Storm
-    presets.push_back({"03 - Grain Storm", {
-        {"position", 0.2f}, {"size", 0.3f}, {"pitch", 0.375f}, {"density", 0.9f}, {"texture", 0.8f},
-        {"in_gain", 0.9f}, {"blend", 0.8f}, {"spread", 0.4f}, {"feedback", 0.1f}, {"reverb", 0.2f},
-        {"mode", 0.0f}, {"quality", 1.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 4: Spectral Wash
-    presets.push_back({"04 - Spectral Wash", {
-        {"position", 0.5f}, {"size", 0.6f}, {"pitch", 0.5f}, {"density", 0.7f}, {"texture", 0.3f},
-        {"in_gain", 0.7f}, {"blend", 1.0f}, {"spread", 0.6f}, {"feedback", 0.0f}, {"reverb", 0.5f},
-        {"mode", 1.0f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 5: Lo-Fi Dream
-    presets.push_back({"05 - Lo-Fi Dream", {
-        {"position", 0.4f}, {"size", 0.5f}, {"pitch", 0.45f}, {"density", 0.4f}, {"texture", 0.9f},
-        {"in_gain", 0.8f}, {"blend", 0.6f}, {"spread", 0.2f}, {"feedback", 0.4f}, {"reverb", 0.3f},
-        {"mode", 0.0f}, {"quality", 0.67f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 6: Frozen Moment
-    presets.push_back({"06 - Frozen Moment", {
-        {"position", 0.5f}, {"size", 0.7f}, {"pitch", 0.5f}, {"density", 0.3f}, {"texture", 0.5f},
-        {"in_gain", 0.8f}, {"blend", 0.9f}, {"spread", 0.5f}, {"feedback", 0.5f}, {"reverb", 0.7f},
-        {"mode", 0.0f}, {"quality", 0.0f}, {"freeze", 1.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 7: Reverse Echo
-    presets.push_back({"07 - Reverse Echo", {
-        {"position", 0.3f}, {"size", 0.6f}, {"pitch", 0.5f}, {"density", 0.6f}, {"texture", 0.4f},
-        {"in_gain", 0.8f}, {"blend", 0.7f}, {"spread", 0.3f}, {"feedback", 0.6f}, {"reverb", 0.4f},
-        {"mode", 0.0f}, {"quality", 0.33f}, {"freeze", 0.0f}, {"sample_mode", 1.0f}
-    }});
-
-    // Preset 8: Shimmer Verb
-    presets.push_back({"08 - Shimmer Verb", {
-        {"position", 0.8f}, {"size", 0.9f}, {"pitch", 0.75f}, {"density", 0.5f}, {"texture", 0.2f},
-        {"in_gain", 0.7f}, {"blend", 0.6f}, {"spread", 1.0f}, {"feedback", 0.2f}, {"reverb", 0.9f},
-        {"mode", 0.0f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 9: Glitch Machine
-    presets.push_back({"09 - Glitch Machine", {
-        {"position", 0.1f}, {"size", 0.1f}, {"pitch", 0.4f}, {"density", 0.95f}, {"texture", 1.0f},
-        {"in_gain", 1.0f}, {"blend", 0.9f}, {"spread", 0.1f}, {"feedback", 0.0f}, {"reverb", 0.1f},
-        {"mode", 0.0f}, {"quality", 0.67f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 10: Pitch Shifter
-    presets.push_back({"10 - Pitch Shifter", {
-        {"position", 0.5f}, {"size", 0.4f}, {"pitch", 0.625f}, {"density", 0.5f}, {"texture", 0.5f},
-        {"in_gain", 0.8f}, {"blend", 1.0f}, {"spread", 0.0f}, {"feedback", 0.0f}, {"reverb", 0.0f},
-        {"mode", 0.33f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 11: Looping Delay
-    presets.push_back({"11 - Looping Delay", {
-        {"position", 0.5f}, {"size", 0.5f}, {"pitch", 0.5f}, {"density", 0.6f}, {"texture", 0.5f},
-        {"in_gain", 0.8f}, {"blend", 0.5f}, {"spread", 0.5f}, {"feedback", 0.7f}, {"reverb", 0.3f},
-        {"mode", 0.67f}, {"quality", 0.33f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 12: Ambient Pad
-    presets.push_back({"12 - Ambient Pad", {
-        {"position", 0.6f}, {"size", 0.85f}, {"pitch", 0.5f}, {"density", 0.45f}, {"texture", 0.3f},
-        {"in_gain", 0.7f}, {"blend", 0.8f}, {"spread", 0.8f}, {"feedback", 0.4f}, {"reverb", 0.8f},
-        {"mode", 0.0f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 13: Octave Up
-    presets.push_back({"13 - Octave Up", {
-        {"position", 0.5f}, {"size", 0.3f}, {"pitch", 0.75f}, {"density", 0.5f}, {"texture", 0.5f},
-        {"in_gain", 0.8f}, {"blend", 0.8f}, {"spread", 0.0f}, {"feedback", 0.0f}, {"reverb", 0.1f},
-        {"mode", 0.33f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 14: Octave Down
-    presets.push_back({"14 - Octave Down", {
-        {"position", 0.5f}, {"size", 0.3f}, {"pitch", 0.25f}, {"density", 0.5f}, {"texture", 0.5f},
-        {"in_gain", 0.8f}, {"blend", 0.8f}, {"spread", 0.0f}, {"feedback", 0.0f}, {"reverb", 0.1f},
-        {"mode", 0.33f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 15: Spectral Freeze
-    presets.push_back({"15 - Spectral Freeze", {
-        {"position", 0.5f}, {"size", 0.5f}, {"pitch", 0.5f}, {"density", 0.8f}, {"texture", 0.6f},
-        {"in_gain", 0.7f}, {"blend", 1.0f}, {"spread", 0.7f}, {"feedback", 0.0f}, {"reverb", 0.6f},
-        {"mode", 1.0f}, {"quality", 0.0f}, {"freeze", 1.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 16: Dense Texture
-    presets.push_back({"16 - Dense Texture", {
-        {"position", 0.4f}, {"size", 0.4f}, {"pitch", 0.48f}, {"density", 0.85f}, {"texture", 0.75f},
-        {"in_gain", 0.85f}, {"blend", 0.75f}, {"spread", 0.6f}, {"feedback", 0.3f}, {"reverb", 0.4f},
-        {"mode", 0.0f}, {"quality", 0.33f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 17: Sparse Grains
-    presets.push_back({"17 - Sparse Grains", {
-        {"position", 0.6f}, {"size", 0.8f}, {"pitch", 0.5f}, {"density", 0.2f}, {"texture", 0.6f},
-        {"in_gain", 0.8f}, {"blend", 0.65f}, {"spread", 0.5f}, {"feedback", 0.2f}, {"reverb", 0.5f},
-        {"mode", 0.0f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 18: Pitch Cascade
-    presets.push_back({"18 - Pitch Cascade", {
-        {"position", 0.3f}, {"size", 0.5f}, {"pitch", 0.35f}, {"density", 0.7f}, {"texture", 0.5f},
-        {"in_gain", 0.8f}, {"blend", 0.7f}, {"spread", 0.4f}, {"feedback", 0.8f}, {"reverb", 0.5f},
-        {"mode", 0.67f}, {"quality", 0.33f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 19: Resonant Delay
-    presets.push_back({"19 - Resonant Delay", {
-        {"position", 0.5f}, {"size", 0.6f}, {"pitch", 0.5f}, {"density", 0.6f}, {"texture", 0.4f},
-        {"in_gain", 0.8f}, {"blend", 0.6f}, {"spread", 0.3f}, {"feedback", 0.9f}, {"reverb", 0.2f},
-        {"mode", 0.67f}, {"quality", 0.0f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
-
-    // Preset 20: Granular Chaos
-    presets.push_back({"20 - Granular Chaos", {
-        {"position", 0.15f}, {"size", 0.2f}, {"pitch", 0.55f}, {"density", 1.0f}, {"texture", 0.95f},
-        {"in_gain", 0.9f}, {"blend", 0.85f}, {"spread", 0.7f}, {"feedback", 0.5f}, {"reverb", 0.3f},
-        {"mode", 0.0f}, {"quality", 0.67f}, {"freeze", 0.0f}, {"sample_mode", 0.0f}
-    }});
+    // Resolve the factory table once: choices snap to their index here, so
+    // loading a preset is a plain copy, and the morph gets plain values.
+    for (int i = 0; i < kNumPresets; ++i)
+    {
+        auto& preset = presets[(size_t)i];
+        preset.name = factoryPresets[i].name;
+
+        for (size_t k = 0; k < numPresetParameters; ++k)
+        {
+            auto* param = parameterTable.getParameter((size_t)presetParameters[k]);
+            float value = juce::jlimit(0.0f, 1.0f, factoryPresets[i].values[k]);
+
+            if (auto* choiceParam = dynamic_cast<juce::AudioParameterChoice*>(param))
+            {
+                int numChoices = choiceParam->choices.size();
+                int targetIndex = juce::jlimit(0, numChoices - 1, (int)(value * numChoices + 0.5f));
+                value = choiceParam->convertTo0to1((float)targetIndex);
+            }
+
+            preset.values[k] = value;
+            if (k < numMorphParameters)
+                preset.morphValues[k] = param->convertFrom0to1(value);
+        }
+    }
 
     currentPresetIndex = 0;
 }
 
 void CloudWashAudioProcessor::loadPreset(int index)
 {
-    if (index < 0 || index >= (int)presets.size())
+    if (index < 0 || index >= kNumPresets)
         return;
 
-    const auto& preset = presets[index];
-
-    for (const auto& [paramName, value] : preset.parameters)
+    // Only what actually changes is sent to the host
+    const auto& preset = presets[(size_t)index];
+    for (size_t k = 0; k < numPresetParameters; ++k)
     {
-        auto* param = apvts.getParameter(paramName);
-        if (param)
-        {
-            // Validate parameter value is within valid range before applying
-            auto range = param->getNormalisableRange();
-            float clampedValue = juce::jlimit(range.start, range.end, value);
-            
-            // Special handling for Choice parameters
-            // The stored values are normalized (0-1), but Choice parameters
-            // need to be converted to indices
-            auto* choiceParam = dynamic_cast<juce::AudioParameterChoice*>(param);
-            if (choiceParam)
-            {
-                // Convert normalized value to index
-                int numChoices = choiceParam->choices.size();
-                int targetIndex = juce::jlimit(0, numChoices - 1, (int)(clampedValue * numChoices + 0.5f));
-                choiceParam->setValueNotifyingHost(choiceParam->convertTo0to1(targetIndex));
-            }
-            else
-            {
-                // For regular parameters, use the clamped value
-                param->setValueNotifyingHost(clampedValue);
-            }
-        }
+        auto* param = parameterTable.getParameter((size_t)presetParameters[k]);
+        if (param->getValue() != preset.values[k])
+            param->setValueNotifyingHost(preset.values[k]);
     }
 
     currentPresetIndex = index;
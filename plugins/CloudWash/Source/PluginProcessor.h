@@ -8,16 +8,27 @@
 
 #include "clouds/dsp/granular_processor.h"
 #include "clouds/dsp/frame.h"
-#include "clouds/dsp/sample_rate_converter.h"
 #include "clouds/resources.h"
 
+#include "PolyphaseResampler.h"
+#include "ParameterCache.h"
+#include "AsyncLogger.h"
+#include "TripleBuffer.h"
+#include "LevelMeter.h"
+#include "RecordingCodec.h"
+#include "SpectralWorker.h"
+#include "RealtimeThreadPool.h"
+#include "QualityGovernor.h"
+
 //==============================================================================
 /**
  * CloudWash - Granular Texture Processor
  *
  * Authentic port of Mutable Instruments Clouds DSP.
  */
-class CloudWashAudioProcessor : public juce::AudioProcessor
+class CloudWashAudioProcessor : public juce::AudioProcessor,
+                                private juce::AudioProcessorValueTreeState::Listener,
+                                private juce::Timer
 {
 public:
     //==============================================================================
@@ -61,15 +72,86 @@ public:
     // Parameter Value Tree State (APVTS)
     juce::AudioProcessorValueTreeState apvts;
 
+    // Compile-time parameter IDs. Order must match parameterIds below.
+    enum class ParamId : size_t
+    {
+        position,
+        size,
+        pitch,
+        density,
+        texture,
+        inGain,
+        blend,
+        spread,
+        feedback,
+        reverb,
+        mode,
+        freeze,
+        trigger,
+        quality,
+        sampleMode,
+        bufferLength,
+        engineRate,
+        morph,
+        morphTarget,
+        recordSource,
+        grainPool,
+        count
+    };
+
+    static constexpr size_t numParameters = static_cast<size_t>(ParamId::count);
+
+    static constexpr std::array<const char*, numParameters> parameterIds {{
+        "position", "size", "pitch", "density", "texture",
+        "in_gain", "blend", "spread", "feedback", "reverb",
+        "mode", "freeze", "trigger", "quality", "sample_mode",
+        "buffer_length", "engine_rate", "morph", "morph_target",
+        "record_source", "grain_pool"
+    }};
+
+    //==============================================================================
+    // PRESETS
+    // Flat, index-ordered tables resolved once in the constructor. The morph
+    // reads them on the audio thread: no allocation, string lookups or host
+    // notification there.
+    //==============================================================================
+    static constexpr int kNumPresets = 20;
+
+    // Parameters a preset sets, in the order of its values
+    static constexpr std::array<ParamId, 14> presetParameters {{
+        ParamId::position, ParamId::size, ParamId::pitch, ParamId::density, ParamId::texture,
+        ParamId::inGain, ParamId::blend, ParamId::spread, ParamId::feedback, ParamId::reverb,
+        ParamId::mode, ParamId::quality, ParamId::freeze, ParamId::sampleMode
+    }};
+    static constexpr size_t numPresetParameters = presetParameters.size();
+
+    // The morph interpolates the continuous controls, the first ones above.
+    // Their ParamId is also their index.
+    static constexpr size_t numMorphParameters = 10;
+
     //==============================================================================
     // AUDIO METERING & VISUALIZATION DATA
     //==============================================================================
+    // Both channels, with instant attack and a fixed release time
     std::atomic<float> inputPeakLevel { 0.0f };
     std::atomic<float> outputPeakLevel { 0.0f };
-    float inputPeakHold { 0.0f };    // Peak hold with decay
-    float outputPeakHold { 0.0f };   // Peak hold with decay
+    std::atomic<float> inputRmsLevel { 0.0f };
+    std::atomic<float> outputRmsLevel { 0.0f };
+
+    // Grain engine state, published by the audio thread once per block and
+    // read by the editor timer
+    struct GrainTelemetry
+    {
+        int activeGrains = 0;
+        int poolSize = 0;                // Grains that can play at once
+        int grainsPerQuality[3] {};      // Indexed by clouds::GrainQuality
+        float gainNormalization = 1.0f;
+        float writeHead = 0.0f;          // Record head position, 0..1
+        float grainBudget = 1.0f;        // Share of the pool the CPU allows
+        float cpuLoad = 0.0f;            // Smoothed, 1: the whole block deadline
+    };
+    TripleBuffer<GrainTelemetry> grainTelemetry;
 
-    std::atomic<int> activeGrainCount { 0 };
     std::atomic<float> grainDensityViz { 0.0f };
     std::atomic<float> grainTextureViz { 0.0f };
 
@@ -77,123 +159,357 @@ public:
     static int getNumQualityModes() { return 5; }
     static juce::String getQualityModeName(int index);
 
+    // Quality index 4: Hi-Fi Stereo on a heap-sized recording buffer
+    static constexpr int kUltraQualityIndex = 4;
+    static constexpr int kMinLongBufferSeconds = 10;
+    static constexpr int kMaxLongBufferSeconds = 60;
+    static int getEngineQuality(int qualityIndex);
+
+    // Grain pool choice 0 keeps the hardware's grain count (32 to 57, by
+    // quality); the others size the pool up to clouds::kMaxNumGrains.
+    static constexpr std::array<int, 4> grainPoolSizes {{ 0, 128, 256, 512 }};
+    static int getGrainPoolSize(int index);
+
+    // Engine rate choice 1 runs Clouds at the host rate, without resampling,
+    // for host rates in this range; outside it the engine stays at 32kHz.
+    static constexpr double kHardwareSampleRate = 32000.0;
+    static constexpr double kMaxNativeSampleRate = 96000.0;
+    double getEngineSampleRate (double hostRate) const;
+
 private:
+    //==============================================================================
+    // Diagnostics; safe to use from the audio thread via CLOUDWASH_LOG_RT
+    AsyncLogger logger;
+
     //==============================================================================
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 
+    // All controls for one block, read once at the top of processBlock()
+    struct ParameterSnapshot
+    {
+        float position, size, pitch, density, texture;
+        float inGain, blend, spread, feedback, reverb;
+        int mode, quality, sampleMode, bufferSeconds, grainPool;
+        bool freeze, trigger;
+        bool recordSidechain;
+        float morph;
+        int morphTarget;
+        int triggerDelay;   // Chunk controls: sample of the chunk the trigger falls on
+        float notePitch;    // Chunk controls: semitones from the last MIDI note
+    };
+
+    ParameterSnapshot readParameters() const;
+
+    // The host hands over one value per parameter and block: the continuous
+    // controls are ramped from the previous block's values, chunk by chunk.
+    ParameterSnapshot previousParameters {};
+    static ParameterSnapshot rampParameters (const ParameterSnapshot& from, const ParameterSnapshot& to, float position);
+
+    // Triggers come from MIDI note-ons and the trigger parameter's rising
+    // edge, each placed on its own sample of the chunk it falls in. A note
+    // also transposes the grains, relative to middle C, until the next one.
+    // Positions count internal samples from the start of the input FIFO.
+    struct NoteTrigger
+    {
+        int position;
+        int note;   // -1: the trigger parameter, no transposition
+    };
+
+    static constexpr int kMiddleC = 60;
+    static constexpr int kMaxSliceTriggers = 64;
+    NoteTrigger pendingTrigger { -1, -1 };  // In the partial chunk left in the FIFO
+    float notePitch { 0.0f };
+
+    // Continuous controls moved toward the morph target preset by amount
+    ParameterSnapshot morphParameters (const ParameterSnapshot& params, float amount) const;
+    static void applyEngineParameters (const ParameterSnapshot& params, clouds::Parameters& p);
+    void publishGrainTelemetry();
+
+    // How long the output can go on after the input stops, for
+    // getTailLengthSeconds(): infinite while frozen, otherwise the reverb's
+    // decay and then until the engines go to sleep (see
+    // clouds::GranularProcessor::sleep_delay(), a pass through the
+    // recording), kMaxTailPasses times with feedback. Set by the audio
+    // thread every block; the host hears of changes from the message thread.
+    std::atomic<double> tailLengthSeconds { 0.0 };
+    std::atomic<bool> tailLengthChanged { false };
+    static constexpr double kMaxTailPasses = 2.0;
+    void updateTailLength (const ParameterSnapshot& params);
+
+    // The engine rate needs a full re-prepare: it is applied by the host's
+    // next prepareToPlay(), which a latency change prompts.
+    void parameterChanged (const juce::String& parameterID, float newValue) override;
+
+    // The audio thread (and automation, which may run on it) only raises
+    // these flags; a message-thread timer passes the changes on.
+    std::atomic<bool> latencyChanged { false };
+    std::atomic<bool> engineRateChanged { false };
+    static constexpr int kHostUpdateIntervalMs = 50;
+    void timerCallback() override;
+
+    // Atomic pointers into apvts, resolved once in the constructor
+    ParameterTable<ParamId, numParameters> parameterTable;
+
     //==============================================================================
     // CLOUDS DSP
     //==============================================================================
 
-    // Memory blocks for the processor (use heap allocation like VCV Rack)
-    uint8_t* block_mem = nullptr;
-    uint8_t* block_ccm = nullptr;
+    // One Clouds engine with its own sample memory (heap allocation like VCV Rack)
+    struct EngineSlot
+    {
+        uint8_t* block_mem = nullptr;
+        uint8_t* block_ccm = nullptr;
+        size_t memCapacity = 0;
+        size_t ccmCapacity = 0;
+        int longBufferSeconds = 0;  // 0: hardware memory sizes
+        double sampleRate = 0.0;    // Engine rate the memory was sized for
+        clouds::GranularProcessor* processor = nullptr;
+    };
+
+    // Clouds is a stereo engine: a bus runs one per left/right channel pair,
+    // and one for the centre channel alone, all with the same controls, mode
+    // and quality (1 for stereo, 3 for 5.1, 4 for 7.1). The LFE channel goes
+    // through unprocessed.
+    static constexpr int kMaxChannelPairs = 4;
+
+    struct ChannelPair
+    {
+        // Bus channels it runs on. A lone channel (the centre) is given twice:
+        // it feeds both inputs and gets the sum of both outputs.
+        int channels[2] { 0, 1 };
+
+        // Two engines: the active one and a shadow that the worker thread
+        // prepares for the next mode/quality. Allocated in prepareToPlay().
+        EngineSlot engineSlots[2];
+
+        // Active engine (audio thread) and the shadow engine, which is the
+        // incoming one during a crossfade. Swapped only by the audio thread,
+        // at the end of a crossfade.
+        clouds::GranularProcessor* processor = nullptr;
+        clouds::GranularProcessor* shadowProcessor = nullptr;
+
+        // Internal buffers for Clouds (FloatFrame - float-native path, no int16 round trip)
+        std::vector<clouds::FloatFrame> inputFrames;
+        std::vector<clouds::FloatFrame> recordFrames;   // Sidechain, when recorded
+        std::vector<clouds::FloatFrame> outputFrames;
+        std::vector<clouds::FloatFrame> shadowFrames;
+
+        // Per chunk of the current host slice, merged into the meters afterwards
+        std::vector<LevelMeter::Accumulator> inputLevels;
+        std::vector<LevelMeter::Accumulator> outputLevels;
 
-    // Use pointer and heap allocation (matches VCV Rack pattern)
-    clouds::GranularProcessor* processor = nullptr;
+        // Active engine and its record head as of the end of the last block,
+        // for getStateInformation() (see RecordingPosition)
+        std::atomic<clouds::GranularProcessor*> recordingEngine { nullptr };
+        std::atomic<int32_t> recordingHead { 0 };
+    };
+
+    ChannelPair channelPairs[kMaxChannelPairs];
+    int numChannelPairs { 1 };  // Of the current layout; pairs beyond keep their engines
+    int numBusChannels { 2 };
+    int lfeChannel { -1 };      // Passed through at the engine rate, for the same latency
+    void assignChannelPairs (const juce::AudioChannelSet& layout);
+
+    void initialiseEngineSlot (EngineSlot& slot, int longBufferSeconds);
+    EngineSlot& getEngineSlot (clouds::GranularProcessor* engine);
+    void releaseEngineSlot (EngineSlot& slot);
+
+    // Channel pairs beyond the first run on these, in parallel with the
+    // audio thread, one host slice at a time.
+    RealtimeThreadPool channelPairWorkers;
     
-    // Resampling state (Host SR -> 32kHz -> Host SR)
+    // Resampling state (Host SR -> engine rate -> Host SR; a straight copy
+    // when the engine runs at the host rate)
+    // resampledInputBuffer is the input FIFO: its first inputFifoCount samples
+    // are a partial chunk carried over to the next host slice.
     juce::AudioBuffer<float> resampledInputBuffer;
     juce::AudioBuffer<float> resampledOutputBuffer;
+    int inputFifoCount { 0 };
+
+    // Optional sidechain bus (mono or stereo). When enabled, it is resampled
+    // alongside the main input into two more FIFO channels, after the main
+    // bus's; with the record source set to it, every channel pair records
+    // grains from it while the main input stays on the dry path.
+    PolyphaseResampler sidechainResampler;
+    bool sidechainEnabled { false };    // Bus layout, fixed in prepareToPlay()
+    bool recordingSidechain { false };  // This block
+
+    // Offline renders (isNonRealtime()) run every grain at the highest
+    // quality; realtime processing goes back to the grain-count tiers.
+    bool renderingOffline { false };
+
+    // Seed of the engines' random draws (grain timing and panning, spectral
+    // phases and glitches); pair i's engines get randomSeed + i. Picked in
+    // prepareToPlay(): fresh for realtime use, so that instances don't play
+    // the same grains, and kOfflineRandomSeed for offline renders, so that
+    // bouncing the same material twice renders the same audio.
+    uint32_t randomSeed { kOfflineRandomSeed };
+    static constexpr uint32_t kOfflineRandomSeed = 0x636c6f75;
+
+    // Processing time per block against its deadline sets the grain budget
+    // the engines get on the next block.
+    QualityGovernor qualityGovernor;
+    float grainBudget { 1.0f };  // This block
+    int maxHostSliceSize { 512 };
+
+    // Clouds always runs on exact kMaxBlockSize chunks. The controls of every
+    // chunk of a host slice are worked out first, on the audio thread; then
+    // each channel pair runs through the whole slice on its own.
+    static constexpr int kCloudsChunkSize = static_cast<int>(clouds::kMaxBlockSize);
+    std::vector<ParameterSnapshot> chunkParameters;
+    int numSliceChunks { 0 };
+    bool crossfading { false };            // Engines switching during this slice
+    float* const* sliceOutputs = nullptr;  // resampledOutputBuffer's channels
+
+    void processChannelPair (int pairIndex);
+    void processCloudsChunk (ChannelPair& pair, int chunk);
+
+    // Spectral frames are transformed on spectralWorker, one hop of latency
+    // behind; the audio thread only catches up when the worker is too late,
+    // or when rendering offline.
+    SpectralWorker spectralWorker;
+    void catchUpSpectralFrames (clouds::GranularProcessor* engine);
+    void processEngine (clouds::GranularProcessor* engine, const clouds::FloatFrame* input,
+                        const clouds::FloatFrame* recordInput, clouds::FloatFrame* output);
+
+    // Morph amount, ramped once per chunk
+    juce::LinearSmoothedValue<float> morphAmount;
+    static constexpr double kMorphRampSeconds = 0.05;
     
-    // VCV Rack-style SampleRateConverter for host rate <-> 32kHz conversion
-    // Uses dsp::SampleRateConverter from VCV Rack's DSP library
-    // This handles arbitrary sample rate ratios properly (44.1k->32k, 48k->32k, etc.)
-    struct VCVStyleSRC {
-        static constexpr int kFilterSize = 45;
-        float history_[kFilterSize * 2][2];  // Double-buffered history for 2 channels
-        int history_ptr_;
-        float coefficients_[kFilterSize];
-        
-        void Init(const float* coeffs = clouds::src_filter_1x_2_45) {
-            for (int i = 0; i < kFilterSize * 2; ++i) {
-                history_[i][0] = 0.0f;
-                history_[i][1] = 0.0f;
-            }
-            for (int i = 0; i < kFilterSize; ++i) {
-                coefficients_[i] = coeffs[i];
-            }
-            history_ptr_ = kFilterSize - 1;
-        }
-        
-        // Process with ratio (positive = upsampling, negative = downsampling)
-        // ratio = -2 means 2:1 downsampling (2 in -> 1 out)
-        // ratio = +2 means 1:2 upsampling (1 in -> 2 out)
-        void Process(const float* inL, const float* inR, float* outL, float* outR, 
-                     size_t input_size, int ratio) {
-            int history_ptr = history_ptr_;
-            const float scale = ratio < 0 ? 1.0f : static_cast<float>(ratio);
-            size_t out_idx = 0;
-            
-            while (input_size > 0) {
-                int consumed = ratio < 0 ? -ratio : 1;
-                for (int i = 0; i < consumed && input_size > 0; ++i) {
-                    // Write to both buffers (double-buffered for wrap-around)
-                    history_[history_ptr + kFilterSize][0] = history_[history_ptr][0] = *inL++;
-                    history_[history_ptr + kFilterSize][1] = history_[history_ptr][1] = *inR++;
-                    --input_size;
-                    --history_ptr;
-                    if (history_ptr < 0) {
-                        history_ptr += kFilterSize;
-                    }
-                }
-                
-                int produced = ratio > 0 ? ratio : 1;
-                for (int i = 0; i < produced; ++i) {
-                    float y_l = 0.0f;
-                    float y_r = 0.0f;
-                    int x_idx = history_ptr + 1;
-                    if (x_idx >= kFilterSize) x_idx -= kFilterSize;
-                    
-                    for (int j = i; j < kFilterSize; j += produced) {
-                        const float h = coefficients_[j];
-                        y_l += history_[x_idx][0] * h;
-                        y_r += history_[x_idx][1] * h;
-                        x_idx += (produced == 1) ? 1 : 0;  // Only advance if consuming one per output
-                        if (x_idx >= kFilterSize) x_idx -= kFilterSize;
-                    }
-                    outL[out_idx] = y_l * scale;
-                    outR[out_idx] = y_r * scale;
-                    ++out_idx;
-                }
-            }
-            history_ptr_ = history_ptr;
-        }
-    };
-    
-    VCVStyleSRC inputSRC;
-    VCVStyleSRC outputSRC;
+    // Continuous-phase polyphase resamplers (Host SR <-> engine rate).
+    // Input runs in push mode (variable internal sample count per block),
+    // output runs in pull mode (always exactly the host block size) behind a
+    // one-chunk cushion, which makes the total latency fixed.
+    PolyphaseResampler inputResampler;
+    PolyphaseResampler outputResampler;
+    int resamplerLatencySamples { 0 };
 
-    // Internal buffers for Clouds (ShortFrame)
-    std::vector<clouds::ShortFrame> inputFrames;
-    std::vector<clouds::ShortFrame> outputFrames;
+    // Latency of the active engine itself (async spectral processing), in
+    // engine samples. Set by the audio thread; reported by updateLatency().
+    std::atomic<int> engineLatencySamples { 0 };
+    void updateLatency();
+
+    // Fed from the chunk conversion loops, at the engine rate. The input is
+    // metered before the input gain.
+    LevelMeter inputMeter;
+    LevelMeter outputMeter;
 
     bool isFrozen { false };
 
     double hostSampleRate = 44100.0;
-    double internalSampleRate = 32000.0;
+    double internalSampleRate = kHardwareSampleRate;  // Engine rate
 
     // High fidelity mixing buffer
     juce::AudioBuffer<float> dryBuffer;
 
-    // Thread safety for DSP re-initialization
+    //==============================================================================
+    // MODE/QUALITY SWITCHING
+    // The audio thread requests a switch; the worker prepares the shadow engine
+    // of every channel pair and publishes them all at once; the audio thread
+    // crossfades (equal power) into them and swaps. Prepare() never runs on
+    // the audio thread.
+    //==============================================================================
+    enum EngineSwitchState
+    {
+        engineSwitchIdle,
+        engineSwitchRequested,
+        engineSwitchReady
+    };
+
+    class EngineSwitchThread : public juce::Thread
+    {
+    public:
+        explicit EngineSwitchThread (CloudWashAudioProcessor& o) : juce::Thread ("CloudWash Engine Switch"), owner (o) {}
+        void run() override;
+
+    private:
+        CloudWashAudioProcessor& owner;
+    };
+
+    void prepareShadowEngine();      // Worker thread
+    void finishEngineSwitch();       // Audio thread
+
+    EngineSwitchThread engineSwitchThread { *this };
+    std::atomic<int> engineSwitchState { engineSwitchIdle };
+    std::atomic<int> requestedMode { 0 };
+    std::atomic<int> requestedQuality { 0 };
+    std::atomic<int> requestedBufferSeconds { 0 };
+    std::atomic<int> requestedGrainPool { 0 };
+    int crossfadePosition { 0 };
+    static constexpr int kEngineCrossfadeSamples = 1024;  // 32 ms at 32kHz
+
+    // Serializes shadow preparation (worker) against prepareToPlay()/destructor.
+    // Never taken on the audio thread.
     std::mutex processorMutex;
 
-    // Quality/Mode change handling (to prevent audio thread blocking)
-    // All atomic for thread safety (parameters can change from message thread)
-    std::atomic<int> pendingMode { -1 };
-    std::atomic<int> pendingQuality { -1 };
-    std::atomic<int> silenceBlocksRemaining { 0 };
+    //==============================================================================
+    // STATE
+    // getStateInformation() writes a binary, tagged-chunk state: parameters,
+    // the engine setup and the active engines' recordings, as blocks from
+    // GetPersistentData() compressed with RecordingCodec. A restored recording
+    // is loaded into the shadow engine by the worker thread and crossfaded in
+    // like any other engine switch. Each channel pair's recording is saved,
+    // tagged with the pair's index.
+    //==============================================================================
+    struct SavedRecording
+    {
+        int mode = 0;
+        int quality = 0;            // Quality index, as the parameter
+        int bufferSeconds = 0;      // Long buffer length, 0 outside Ultra HQ
+        double sampleRate = 0.0;    // Engine rate
+        // Tagged blocks, as LoadPersistentData() reads them; empty for a
+        // pair that was not saved
+        std::array<std::vector<uint32_t>, kMaxChannelPairs> images;
+    };
+
+    bool readBinaryState (const void* data, int sizeInBytes);
+
+    std::unique_ptr<SavedRecording> pendingRecording;   // Guarded by processorMutex
+    std::atomic<bool> recordingRestorePending { false };
+
+    // The recording keeps changing while the audio thread runs; it is
+    // copied on the caller's thread, seqlock-style. processBlock() keeps
+    // recordingSequence odd while it runs the engines, and publishes each
+    // pair's active engine and record head before making it even again. A
+    // copy that overlapped blocks is patched by copying again only what
+    // they recorded, until a pass gets through with no block in between.
+    // A stopped host runs no block: the first pass is the last one.
+    struct RecordingPosition
+    {
+        uint32_t sequence = 1;                        // Odd: a block was running
+        clouds::GranularProcessor* engine = nullptr;
+        int32_t head = 0;
+        int64_t samplesProcessed = 0;                 // Engine samples, since prepared
+    };
+
+    struct RecordingSnapshot
+    {
+        clouds::GranularProcessor* engine = nullptr;  // Sized for this one
+        clouds::PersistentState state {};
+        std::vector<std::vector<uint8_t>> buffers;
+    };
+
+    RecordingPosition readRecordingPosition (const ChannelPair& pair) const;
+    bool copyRecording (const ChannelPair& pair, RecordingSnapshot& snapshot);
+
+    std::atomic<uint32_t> recordingSequence { 0 };
+    std::atomic<int64_t> engineSamplesProcessed { 0 };  // Written by the audio thread only
+    static constexpr int kMaxSnapshotPasses = 16;
+
     std::atomic<int> currentMode { 0 };
     std::atomic<int> currentQuality { 0 };
+    std::atomic<int> currentBufferSeconds { 0 };
+    std::atomic<int> currentGrainPool { 0 };
     std::atomic<bool> cloudsInitialized { false };  // Track if Clouds processor is initialized
 
     // Preset management
-    struct PresetData {
+    struct PresetData
+    {
         juce::String name;
-        std::map<juce::String, float> parameters;
+        std::array<float, numPresetParameters> values {};       // Normalised
+        std::array<float, numMorphParameters> morphValues {};   // Plain, as in ParameterSnapshot
     };
-    std::vector<PresetData> presets;
+    std::array<PresetData, kNumPresets> presets;
     int currentPresetIndex { 0 };
     void initializePresets();
     void loadPreset(int index);
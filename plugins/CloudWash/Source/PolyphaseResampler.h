@@ -0,0 +1,306 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <vector>
+#include <numeric>
+#include <cmath>
+
+//==============================================================================
+/**
+ * Stateful rational polyphase resampler (windowed-sinc, Kaiser window).
+ *
+ * Converts between two fixed rates by the exact ratio L/M (interpolation L,
+ * decimation M). Phase and filter history are carried across calls, so there
+ * is no drift and no discontinuity at host block edges. One coefficient bank
+ * of L phases x kTapsPerPhase taps is built per ratio in prepare(), and each
+ * output is a single contiguous dot product that the compiler vectorises.
+ *
+ * Two ways of driving it:
+ *  - process(): push mode. Consumes every input sample and returns however
+ *    many output samples that produced (used for host -> internal rate).
+ *  - pushInput()/pull(): pull mode. Input is queued, and pull() renders
+ *    exactly the number of output samples requested (used for internal ->
+ *    host rate, where the host block size is fixed). The queue is primed with
+ *    getPullCushion() samples of silence so it never runs dry; the cushion
+ *    must cover however far the producer can lag behind the consumer.
+ *
+ * When both rates are equal (L == M == 1) no filter is built and samples are
+ * passed straight through, with no group delay.
+ */
+class PolyphaseResampler
+{
+public:
+    static constexpr int kTapsPerPhase = 32;
+    static constexpr int kMaxPhases = 1024;
+    static constexpr int kMaxChannels = 8;  // 7.1
+    static constexpr int kDefaultPullCushion = 4;
+
+    PolyphaseResampler() = default;
+
+    /** Finds the smallest L/M equal to outputRate/inputRate, capped to kMaxPhases. */
+    static void getRationalRatio (double inputRate, double outputRate, int& interpolation, int& decimation)
+    {
+        auto in = (int) std::lround (inputRate);
+        auto out = (int) std::lround (outputRate);
+        auto divisor = std::gcd (in, out);
+        interpolation = out / divisor;
+        decimation = in / divisor;
+
+        // Unusual rates: approximate the ratio with a bounded phase count.
+        // Both directions use the exact inverse of each other, so the chain
+        // still cannot drift.
+        if (interpolation > kMaxPhases || decimation > kMaxPhases * 16)
+        {
+            interpolation = kMaxPhases;
+            decimation = juce::jmax (1, (int) std::lround (kMaxPhases * inputRate / outputRate));
+        }
+    }
+
+    /** Builds the coefficient bank for the ratio L/M and resets all state. */
+    void prepare (int interpolation, int decimation, int numChannels, int maxPullQueueSize,
+                  int pullCushion = kDefaultPullCushion)
+    {
+        interp = juce::jmax (1, interpolation);
+        decim = juce::jmax (1, decimation);
+        channels = juce::jlimit (1, kMaxChannels, numChannels);
+
+        cushion = juce::jmax (0, pullCushion);
+        queueSize = juce::jmax (maxPullQueueSize, cushion) + cushion + kTapsPerPhase;
+        for (auto& q : queue)
+            q.assign ((size_t) queueSize, 0.0f);
+
+        if (isIdentity())
+        {
+            interp = decim = 1;
+            bank.clear();
+            reset();
+            return;
+        }
+
+        // Prototype low-pass at L * inputRate, cut below the lower Nyquist.
+        const int length = kTapsPerPhase * interp;
+        const double cutoff = 0.5 * 0.85 / (double) juce::jmax (interp, decim);
+        const double centre = 0.5 * (double) (length - 1);
+        const double beta = 7.0;
+        const double i0Beta = besselI0 (beta);
+
+        std::vector<double> prototype ((size_t) length);
+        for (int n = 0; n < length; ++n)
+        {
+            const double x = (double) n - centre;
+            const double sinc = x == 0.0 ? 1.0
+                                         : std::sin (2.0 * juce::MathConstants<double>::pi * cutoff * x)
+                                               / (2.0 * juce::MathConstants<double>::pi * cutoff * x);
+            const double r = x / (centre + 1.0);
+            const double window = besselI0 (beta * std::sqrt (juce::jmax (0.0, 1.0 - r * r))) / i0Beta;
+            prototype[(size_t) n] = 2.0 * cutoff * sinc * window * (double) interp;
+        }
+
+        // Polyphase decomposition: bank[phase][k] = h[k * L + phase].
+        bank.assign ((size_t) (interp * kTapsPerPhase), 0.0f);
+        for (int phase = 0; phase < interp; ++phase)
+            for (int k = 0; k < kTapsPerPhase; ++k)
+                bank[(size_t) (phase * kTapsPerPhase + k)] = (float) prototype[(size_t) (k * interp + phase)];
+
+        reset();
+    }
+
+    /** Clears history and phase, and re-primes the pull queue with silence. */
+    void reset()
+    {
+        for (auto& h : history)
+            std::fill (std::begin (h), std::end (h), 0.0f);
+
+        historyPtr = kTapsPerPhase - 1;
+        phase = interp;  // Consume one input before the first output.
+
+        queueRead = 0;
+        queueCount = cushion;
+        for (auto& q : queue)
+            std::fill (q.begin(), q.end(), 0.0f);
+    }
+
+    /** Push mode: consumes numInput samples, returns the number of outputs written. */
+    int process (const float* const* input, int numInput, float* const* output, int maxOutput)
+    {
+        if (isIdentity())
+        {
+            const int produced = juce::jmin (numInput, maxOutput);
+            for (int ch = 0; ch < channels; ++ch)
+                std::copy (input[ch], input[ch] + produced, output[ch]);
+            return produced;
+        }
+
+        int consumed = 0;
+        int produced = 0;
+
+        while (produced < maxOutput)
+        {
+            while (phase >= interp)
+            {
+                if (consumed == numInput)
+                    return produced;
+
+                for (int ch = 0; ch < channels; ++ch)
+                    pushSample (ch, input[ch][consumed]);
+                advanceHistory();
+
+                ++consumed;
+                phase -= interp;
+            }
+
+            renderOutput (output, produced);
+            ++produced;
+            phase += decim;
+        }
+
+        // Output full: remaining input is still taken into the history so the
+        // stream stays continuous, at the cost of the outputs it would make.
+        for (; consumed < numInput; ++consumed)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+                pushSample (ch, input[ch][consumed]);
+            advanceHistory();
+        }
+
+        return produced;
+    }
+
+    /** Pull mode: queues input samples for subsequent pull() calls. */
+    void pushInput (const float* const* input, int numInput)
+    {
+        numInput = juce::jmin (numInput, queueSize - queueCount);
+        for (int i = 0; i < numInput; ++i)
+        {
+            const int writeIndex = (queueRead + queueCount + i) % queueSize;
+            for (int ch = 0; ch < channels; ++ch)
+                queue[ch][(size_t) writeIndex] = input[ch][i];
+        }
+        queueCount += numInput;
+    }
+
+    /** Pull mode: renders exactly numOutput samples from the queued input. */
+    void pull (float* const* output, int numOutput)
+    {
+        if (isIdentity())
+        {
+            pullDirect (output, numOutput);
+            return;
+        }
+
+        for (int produced = 0; produced < numOutput; ++produced)
+        {
+            while (phase >= interp)
+            {
+                for (int ch = 0; ch < channels; ++ch)
+                    pushSample (ch, queueCount > 0 ? queue[ch][(size_t) queueRead] : 0.0f);
+                advanceHistory();
+
+                if (queueCount > 0)
+                {
+                    queueRead = (queueRead + 1) % queueSize;
+                    --queueCount;
+                }
+                phase -= interp;
+            }
+
+            renderOutput (output, produced);
+            phase += decim;
+        }
+    }
+
+    /** Upper bound of the outputs produced by process() for numInput inputs. */
+    int getMaxOutputFor (int numInput) const
+    {
+        return (int) (((juce::int64) numInput * interp) / decim) + 2;
+    }
+
+    /** Silence pre-loaded into the pull queue, in input samples. */
+    int getPullCushion() const { return cushion; }
+
+    /** Group delay of the filter, in input samples. */
+    double getFilterDelay() const { return isIdentity() ? 0.0 : 0.5 * ((double) kTapsPerPhase - 1.0 / (double) interp); }
+
+    bool isIdentity() const { return interp == decim; }
+
+private:
+    static double besselI0 (double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            const double t = x / (2.0 * k);
+            term *= t * t;
+            sum += term;
+        }
+        return sum;
+    }
+
+    void pullDirect (float* const* output, int numOutput)
+    {
+        const int available = juce::jmin (numOutput, queueCount);
+        for (int i = 0; i < available; ++i)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+                output[ch][i] = queue[ch][(size_t) queueRead];
+            queueRead = (queueRead + 1) % queueSize;
+        }
+        queueCount -= available;
+
+        for (int ch = 0; ch < channels; ++ch)
+            std::fill (output[ch] + available, output[ch] + numOutput, 0.0f);
+    }
+
+    inline void pushSample (int ch, float x)
+    {
+        // Double-buffered history: the newest kTapsPerPhase samples are always
+        // contiguous starting at historyPtr.
+        history[ch][historyPtr] = x;
+        history[ch][historyPtr + kTapsPerPhase] = x;
+    }
+
+    inline void advanceHistory()
+    {
+        if (--historyPtr < 0)
+            historyPtr += kTapsPerPhase;
+    }
+
+    inline void renderOutput (float* const* output, int index)
+    {
+        // historyPtr points one below the newest sample after advanceHistory().
+        const int start = historyPtr + 1;
+        const float* h = &bank[(size_t) (phase * kTapsPerPhase)];
+
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            const float* x = &history[ch][start];
+            float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int k = 0; k < kTapsPerPhase; k += 4)
+            {
+                acc[0] += h[k + 0] * x[k + 0];
+                acc[1] += h[k + 1] * x[k + 1];
+                acc[2] += h[k + 2] * x[k + 2];
+                acc[3] += h[k + 3] * x[k + 3];
+            }
+            output[ch][index] = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+        }
+    }
+
+    int interp = 1;
+    int decim = 1;
+    int channels = 2;
+    int phase = 1;
+
+    std::vector<float> bank;
+    alignas (16) float history[kMaxChannels][kTapsPerPhase * 2 + 1] {};
+    int historyPtr = kTapsPerPhase - 1;
+
+    std::vector<float> queue[kMaxChannels];
+    int queueSize = 0;
+    int queueRead = 0;
+    int queueCount = 0;
+    int cushion = kDefaultPullCushion;
+
+    JUCE_DECLARE_NON_COPYABLE (PolyphaseResampler)
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cstdint>
+
+//==============================================================================
+/**
+ * Deadline-aware grain budget for the audio thread.
+ *
+ * Each block's processing time is measured against its deadline (the block's
+ * duration at the host rate) and folded into a smoothed load, where 1.0 means
+ * the whole deadline was used. The grain budget, in (kMinBudget, 1], follows
+ * it: cut multiplicatively as soon as the load crosses kHighLoad, so a dense
+ * patch sheds work within a few blocks, and given back slowly below kLowLoad,
+ * so the engines do not oscillate between tiers. In between it holds.
+ *
+ * The budget scales the live grain count and the quality tiers of
+ * clouds::GranularSamplePlayer (see set_grain_budget()).
+ *
+ * Audio thread only; the owner publishes getLoad()/getBudget() where needed.
+ */
+class QualityGovernor
+{
+public:
+    static constexpr float kHighLoad = 0.7f;
+    static constexpr float kLowLoad = 0.45f;
+    static constexpr float kMinBudget = 0.125f;
+
+    QualityGovernor() = default;
+
+    void prepare (double sampleRate)
+    {
+        ticksPerSample = (double) juce::Time::getHighResolutionTicksPerSecond() / sampleRate;
+        reset();
+    }
+
+    void reset()
+    {
+        load = 0.0f;
+        budget = 1.0f;
+    }
+
+    /** Audio thread: call at the top of the block. */
+    void startBlock() noexcept { blockStart = juce::Time::getHighResolutionTicks(); }
+
+    /** Audio thread: call at the end of a block of numSamples host samples. */
+    void endBlock (int numSamples) noexcept
+    {
+        const double deadline = ticksPerSample * (double) juce::jmax (1, numSamples);
+        const float blockLoad = (float) ((double) (juce::Time::getHighResolutionTicks() - blockStart) / deadline);
+
+        // Fast attack, so a spike is caught on the next block; slow release
+        load += (blockLoad - load) * (blockLoad > load ? 0.5f : 0.05f);
+
+        if (load > kHighLoad)
+            budget = std::max (kMinBudget, budget * 0.8f);
+        else if (load < kLowLoad)
+            budget = std::min (1.0f, budget + 0.01f);
+    }
+
+    /** Offline renders have no deadline: the full budget, whatever the load. */
+    void setUnlimited() noexcept { budget = 1.0f; }
+
+    float getLoad() const noexcept   { return load; }
+    float getBudget() const noexcept { return budget; }
+
+private:
+    double ticksPerSample = 1.0;
+    juce::int64 blockStart = 0;
+    float load = 0.0f;
+    float budget = 1.0f;
+
+    JUCE_DECLARE_NON_COPYABLE (QualityGovernor)
+};
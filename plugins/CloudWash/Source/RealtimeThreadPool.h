@@ -0,0 +1,176 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+/**
+ * A few realtime worker threads that help the audio thread through a batch of
+ * independent jobs: the channel pairs of a surround or ambisonic bus.
+ *
+ * run() publishes the batch and works on it too. Every thread, the caller
+ * included, steals the next unclaimed job from the shared batch until none
+ * is left, so a pair that is expensive this block (spectral mode, a dense
+ * grain cloud) never holds back the others. The claim counter is tagged with
+ * the batch number, so a worker waking up late cannot take a job from a batch
+ * it did not see published.
+ *
+ * Idle workers spin briefly, then sleep; the audio thread only signals one
+ * that is actually asleep. With no workers, run() is a plain loop.
+ */
+class RealtimeThreadPool
+{
+public:
+    RealtimeThreadPool() = default;
+    ~RealtimeThreadPool() { stop(); }
+
+    /** Message thread, with no run() in progress: (re)starts numWorkers
+        threads, prioritised for blocks of blockSize samples at sampleRate. */
+    void start (int numWorkers, int blockSize, double sampleRate)
+    {
+        if (numWorkers == (int) workers.size())
+            return;
+
+        stop();
+        const auto options = juce::Thread::RealtimeOptions {}
+                                 .withApproximateAudioProcessingTime (juce::jmax (1, blockSize), sampleRate);
+
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            workers.push_back (std::make_unique<Worker> (*this, i));
+            if (! workers.back()->startRealtimeThread (options))
+                workers.back()->startThread (juce::Thread::Priority::highest);
+        }
+    }
+
+    void stop()
+    {
+        for (auto& worker : workers)
+        {
+            worker->signalThreadShouldExit();
+            worker->notify();
+        }
+        for (auto& worker : workers)
+            worker->stopThread (1000);
+        workers.clear();
+    }
+
+    int getNumWorkers() const noexcept { return (int) workers.size(); }
+
+    /** Audio thread: calls job (index) for every index below numJobs, spread
+        over the workers and the calling thread; returns once all are done. */
+    template <typename Job>
+    void run (int numJobs, Job& job) noexcept
+    {
+        jassert (numJobs <= kMaxJobs);
+        if (workers.empty() || numJobs <= 1)
+        {
+            for (int i = 0; i < numJobs; ++i)
+                job (i);
+            return;
+        }
+
+        jobFunction = [] (void* context, int index) { (*static_cast<Job*> (context)) (index); };
+        jobContext = &job;
+        numDone.store (0, std::memory_order_relaxed);
+
+        batch = (batch + 1) & kBatchMask;
+        claim.store (makeClaim (batch, numJobs, 0));  // Publishes the fields above
+
+        // Pairs with the worker's sleeping flag: either it sees the batch, or
+        // we see it asleep.
+        for (auto& worker : workers)
+            if (worker->asleep.load())
+                worker->notify();
+
+        workOnBatch();
+        while (numDone.load (std::memory_order_acquire) < numJobs)
+            ;  // The last jobs are running on workers
+    }
+
+private:
+    static constexpr int kMaxJobs = 255;
+    static constexpr int kIdleSpins = 1000;  // Yields before a worker sleeps
+    static constexpr uint64_t kBatchMask = (1ull << 48) - 1;
+
+    // Batch number (48 bits), job count and next job (8 bits each)
+    static uint64_t makeClaim (uint64_t batchNumber, int numJobs, int next) noexcept
+    {
+        return (batchNumber << 16) | ((uint64_t) numJobs << 8) | (uint64_t) next;
+    }
+
+    static int getNumJobs (uint64_t c) noexcept  { return (int) ((c >> 8) & 0xff); }
+    static int getNextJob (uint64_t c) noexcept  { return (int) (c & 0xff); }
+
+    bool hasWork() const noexcept
+    {
+        const auto c = claim.load();  // Sequentially consistent, for the sleeping flag
+        return getNextJob (c) < getNumJobs (c);
+    }
+
+    void workOnBatch() noexcept
+    {
+        auto c = claim.load (std::memory_order_acquire);
+        while (getNextJob (c) < getNumJobs (c))
+        {
+            if (! claim.compare_exchange_weak (c, c + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+                continue;
+
+            jobFunction (jobContext, getNextJob (c));
+            numDone.fetch_add (1, std::memory_order_release);
+            c = claim.load (std::memory_order_acquire);
+        }
+    }
+
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker (RealtimeThreadPool& o, int index)
+            : juce::Thread ("CloudWash Worker " + juce::String (index + 1)), owner (o) {}
+
+        void run() override
+        {
+            int idleSpins = 0;
+            while (! threadShouldExit())
+            {
+                if (owner.hasWork())
+                {
+                    owner.workOnBatch();
+                    idleSpins = 0;
+                }
+                else if (++idleSpins < kIdleSpins)
+                {
+                    juce::Thread::yield();
+                }
+                else
+                {
+                    asleep.store (true);
+                    if (! owner.hasWork() && ! threadShouldExit())
+                        wait (-1);
+                    asleep.store (false);
+                    idleSpins = 0;
+                }
+            }
+        }
+
+        std::atomic<bool> asleep { false };
+
+    private:
+        RealtimeThreadPool& owner;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Written by run() before the claim that publishes them
+    void (*jobFunction) (void*, int) = nullptr;
+    void* jobContext = nullptr;
+    uint64_t batch = 0;  // Audio thread only
+
+    std::atomic<uint64_t> claim { 0 };
+    std::atomic<int> numDone { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeThreadPool)
+};
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+//==============================================================================
+/**
+ * Lossless compression for Clouds recording buffers in the plugin state.
+ *
+ * Each sample is predicted from the previous ones (second order for 16-bit
+ * audio, first order for bytes: mu-law codes and spectral data), and the
+ * zigzag-folded residual is Rice coded in blocks of kBlockSize samples, each
+ * with its own Rice parameter. A block whose residuals are all zero (silence,
+ * a never-written buffer) costs a single 5-bit header. Incompressible data is
+ * stored raw. This is the scheme FLAC uses with its fixed predictors, without
+ * the framing.
+ *
+ * Block header: 5 bits. 0-30: Rice parameter k; kSilentBlock: all zero.
+ * Residual:     q = u >> k as q ones and a zero, then the k low bits of u.
+ *               q >= kEscapeQuotient: kEscapeQuotient ones, then u verbatim.
+ */
+class RecordingCodec
+{
+public:
+    enum Encoding : uint8_t
+    {
+        encodingRaw,
+        encodingRice16,
+        encodingRice8
+    };
+
+    /** Appends the encoded form of numBytes bytes of data to out; returns the encoding used. */
+    static Encoding encode (const void* data, size_t numBytes, bool sixteenBit, std::vector<uint8_t>& out)
+    {
+        const size_t start = out.size();
+        const bool words = sixteenBit && (numBytes & 1) == 0;
+
+        if (words)
+            encodeRice<uint16_t, 2> (data, numBytes / 2, out);
+        else
+            encodeRice<uint8_t, 1> (data, numBytes, out);
+
+        if (out.size() - start < numBytes)
+            return words ? encodingRice16 : encodingRice8;
+
+        out.resize (start);
+        const auto* bytes = static_cast<const uint8_t*> (data);
+        out.insert (out.end(), bytes, bytes + numBytes);
+        return encodingRaw;
+    }
+
+    /** Decodes exactly numBytes bytes into dest. Returns false on malformed input. */
+    static bool decode (Encoding encoding, const uint8_t* src, size_t srcSize, void* dest, size_t numBytes)
+    {
+        switch (encoding)
+        {
+            case encodingRaw:
+                if (srcSize != numBytes)
+                    return false;
+                std::memcpy (dest, src, numBytes);
+                return true;
+
+            case encodingRice16:
+                return (numBytes & 1) == 0 && decodeRice<uint16_t, 2> (src, srcSize, dest, numBytes / 2);
+
+            case encodingRice8:
+                return decodeRice<uint8_t, 1> (src, srcSize, dest, numBytes);
+
+            default:
+                return false;
+        }
+    }
+
+private:
+    static constexpr int kBlockSize = 256;
+    static constexpr uint32_t kSilentBlock = 31;
+    static constexpr uint32_t kEscapeQuotient = 24;
+
+    // MSB-first bit packing through a 64-bit accumulator. Callers never
+    // write more than 32 bits at once.
+    class BitWriter
+    {
+    public:
+        explicit BitWriter (std::vector<uint8_t>& o) : out (o) {}
+        ~BitWriter() { flush(); }
+
+        void write (uint32_t value, int numBits)
+        {
+            if (numBits == 0)
+                return;
+            accumulator = (accumulator << numBits) | (value & (uint32_t) ((1ull << numBits) - 1));
+            numPending += numBits;
+            while (numPending >= 8)
+            {
+                numPending -= 8;
+                out.push_back ((uint8_t) (accumulator >> numPending));
+            }
+        }
+
+        void writeOnes (uint32_t count) { write ((uint32_t) ((1ull << count) - 1), (int) count); }
+        void writeBit (uint32_t bit)    { write (bit, 1); }
+
+        void flush()
+        {
+            if (numPending > 0)
+                out.push_back ((uint8_t) (accumulator << (8 - numPending)));
+            accumulator = 0;
+            numPending = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+        uint64_t accumulator = 0;
+        int numPending = 0;
+    };
+
+    class BitReader
+    {
+    public:
+        BitReader (const uint8_t* s, size_t n) : src (s), size (n) {}
+
+        bool read (int numBits, uint32_t& value)
+        {
+            value = 0;
+            if (numBits == 0)
+                return true;
+            if (! refill (numBits))
+                return false;
+            numBuffered -= numBits;
+            value = (uint32_t) (buffer >> numBuffered) & (uint32_t) ((1ull << numBits) - 1);
+            return true;
+        }
+
+        bool readBit (uint32_t& bit) { return read (1, bit); }
+
+        /** True if only the zero padding of the last byte is left. */
+        bool atEnd() const { return position == size && numBuffered < 8; }
+
+    private:
+        bool refill (int numBits)
+        {
+            while (numBuffered < numBits)
+            {
+                if (position == size)
+                    return false;
+                buffer = (buffer << 8) | src[position++];
+                numBuffered += 8;
+            }
+            return true;
+        }
+
+        const uint8_t* src;
+        size_t size;
+        size_t position = 0;
+        uint64_t buffer = 0;
+        int numBuffered = 0;
+    };
+
+    // Residual against a fixed predictor of the given order, in the sample's
+    // own wrapping arithmetic so decoding is exact.
+    template <typename Sample, int order>
+    static Sample predict (Sample x1, Sample x2)
+    {
+        if constexpr (order == 2)
+            return (Sample) (2 * x1 - x2);
+        else
+            return x1;
+    }
+
+    template <typename Sample>
+    static uint32_t zigzag (Sample residual)
+    {
+        const auto r = (int32_t) (typename std::make_signed<Sample>::type) residual;
+        return ((uint32_t) r << 1) ^ (uint32_t) (r >> 31);
+    }
+
+    template <typename Sample>
+    static Sample unzigzag (uint32_t u)
+    {
+        return (Sample) ((u >> 1) ^ (0u - (u & 1)));
+    }
+
+    template <typename Sample, int order>
+    static void encodeRice (const void* data, size_t numSamples, std::vector<uint8_t>& out)
+    {
+        constexpr int kSampleBits = (int) sizeof (Sample) * 8;
+        BitWriter writer (out);
+        Sample x1 = 0, x2 = 0;
+        uint32_t residuals[kBlockSize];
+
+        for (size_t blockStart = 0; blockStart < numSamples; blockStart += kBlockSize)
+        {
+            const int blockSize = (int) std::min<size_t> (kBlockSize, numSamples - blockStart);
+            uint64_t sum = 0;
+
+            for (int i = 0; i < blockSize; ++i)
+            {
+                Sample x;
+                std::memcpy (&x, static_cast<const uint8_t*> (data) + (blockStart + (size_t) i) * sizeof (Sample), sizeof (Sample));
+                residuals[i] = zigzag<Sample> ((Sample) (x - predict<Sample, order> (x1, x2)));
+                sum += residuals[i];
+                x2 = x1;
+                x1 = x;
+            }
+
+            if (sum == 0)
+            {
+                writer.write (kSilentBlock, 5);
+                continue;
+            }
+
+            // Rice parameter close to log2 of the mean residual
+            uint32_t k = 0;
+            const uint64_t mean = sum / (uint64_t) blockSize;
+            while (k < (uint32_t) kSampleBits - 1 && (1ull << (k + 1)) <= mean)
+                ++k;
+
+            writer.write (k, 5);
+            for (int i = 0; i < blockSize; ++i)
+            {
+                const uint32_t q = residuals[i] >> k;
+                if (q >= kEscapeQuotient)
+                {
+                    writer.writeOnes (kEscapeQuotient);
+                    writer.write (residuals[i], kSampleBits);
+                }
+                else
+                {
+                    writer.writeOnes (q);
+                    writer.writeBit (0);
+                    writer.write (residuals[i], (int) k);
+                }
+            }
+        }
+    }
+
+    template <typename Sample, int order>
+    static bool decodeRice (const uint8_t* src, size_t srcSize, void* dest, size_t numSamples)
+    {
+        constexpr int kSampleBits = (int) sizeof (Sample) * 8;
+        BitReader reader (src, srcSize);
+        auto* out = static_cast<uint8_t*> (dest);
+        Sample x1 = 0, x2 = 0;
+
+        for (size_t blockStart = 0; blockStart < numSamples; blockStart += kBlockSize)
+        {
+            const int blockSize = (int) std::min<size_t> (kBlockSize, numSamples - blockStart);
+
+            uint32_t k;
+            if (! reader.read (5, k) || (k >= (uint32_t) kSampleBits && k != kSilentBlock))
+                return false;
+
+            for (int i = 0; i < blockSize; ++i)
+            {
+                uint32_t u = 0;
+                if (k != kSilentBlock)
+                {
+                    uint32_t q = 0, bit = 1;
+                    while (q < kEscapeQuotient)
+                    {
+                        if (! reader.readBit (bit))
+                            return false;
+                        if (bit == 0)
+                            break;
+                        ++q;
+                    }
+
+                    uint32_t low;
+                    if (q == kEscapeQuotient)
+                    {
+                        if (! reader.read (kSampleBits, u))
+                            return false;
+                    }
+                    else
+                    {
+                        if (! reader.read ((int) k, low))
+                            return false;
+                        u = (q << k) | low;
+                    }
+                }
+
+                const auto x = (Sample) (predict<Sample, order> (x1, x2) + unzigzag<Sample> (u));
+                std::memcpy (out + (blockStart + (size_t) i) * sizeof (Sample), &x, sizeof (Sample));
+                x2 = x1;
+                x1 = x;
+            }
+        }
+
+        return reader.atEnd();
+    }
+};
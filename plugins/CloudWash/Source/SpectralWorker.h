@@ -0,0 +1,129 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "clouds/dsp/granular_processor.h"
+
+//==============================================================================
+/**
+ * Background thread for the spectral mode's frame processing (FFT, frame
+ * transformation, IFFT), which used to run inline once per hop.
+ *
+ * Whichever thread runs an engine (the audio thread, or a channel pair
+ * worker) posts it through a lock-free queue each time one of its frames is
+ * complete; the worker transforms everything pending for it. Engines run with async spectral processing, so a frame may be up to a
+ * hop late: if the worker falls further behind, the audio thread catches up
+ * itself (clouds::PhaseVocoder::Buffer() lets only one thread in at a time).
+ * The worker runs at audio priority, like the channel pair workers, so the
+ * audio thread never waits behind a lower priority thread.
+ */
+class SpectralWorker
+{
+public:
+    static constexpr int kQueueSize = 16;  // Jobs, power of two
+
+    SpectralWorker() = default;
+    ~SpectralWorker() { stop(); }
+
+    void start (int blockSize, double sampleRate)
+    {
+        if (thread.isThreadRunning())
+            return;
+
+        const auto options = juce::Thread::RealtimeOptions {}
+                                 .withApproximateAudioProcessingTime (juce::jmax (1, blockSize), sampleRate);
+        if (! thread.startRealtimeThread (options))
+            thread.startThread (juce::Thread::Priority::highest);
+    }
+
+    void stop()
+    {
+        thread.stopThread (1000);
+    }
+
+    /** Any number of realtime threads. Returns false if the queue is full. */
+    bool post (clouds::GranularProcessor* engine) noexcept
+    {
+        // Claim a slot; the worker empties a slot before moving past it, so
+        // a claimed slot is free.
+        auto h = head.load (std::memory_order_relaxed);
+        do
+        {
+            if (h - tail.load (std::memory_order_acquire) >= (uint32_t) kQueueSize)
+                return false;
+        }
+        while (! head.compare_exchange_weak (h, h + 1, std::memory_order_relaxed));
+
+        numPending.fetch_add (1, std::memory_order_relaxed);
+        jobs[h & (kQueueSize - 1)].store (engine, std::memory_order_release);
+        return true;
+    }
+
+    /** Any thread: true when every posted job is done. Once no engine runs,
+        it stays true until one posts again. */
+    bool isIdle() const noexcept
+    {
+        return numPending.load (std::memory_order_acquire) == 0;
+    }
+
+    /** Any thread but the audio thread: waits until every posted job is done.
+        Call it before re-initialising an engine the audio thread no longer runs. */
+    void waitUntilIdle() const
+    {
+        while (numPending.load (std::memory_order_acquire) > 0 && thread.isThreadRunning())
+            juce::Thread::sleep (1);
+    }
+
+private:
+    class WorkerThread : public juce::Thread
+    {
+    public:
+        explicit WorkerThread (SpectralWorker& o) : juce::Thread ("CloudWash Spectral"), owner (o) {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                // Polling keeps the audio thread free of any signalling; a
+                // frame has a hop (32 ms at 32kHz) to get done.
+                if (! owner.processNextJob())
+                    wait (1);
+            }
+        }
+
+    private:
+        SpectralWorker& owner;
+    };
+
+    bool processNextJob()
+    {
+        // Producers may fill their slots out of order: oldest first.
+        const auto t = tail.load (std::memory_order_relaxed);
+        auto& job = jobs[t & (kQueueSize - 1)];
+        auto* engine = job.load (std::memory_order_acquire);
+        if (engine == nullptr)
+            return false;
+
+        while (engine->spectral_frames_pending() > 0)
+            if (! engine->Buffer())
+                juce::Thread::yield();  // The audio thread is catching up
+
+        job.store (nullptr, std::memory_order_relaxed);
+        tail.store (t + 1, std::memory_order_release);
+        numPending.fetch_sub (1, std::memory_order_release);
+        return true;
+    }
+
+    std::array<std::atomic<clouds::GranularProcessor*>, kQueueSize> jobs {};
+    std::atomic<uint32_t> head { 0 };
+    std::atomic<uint32_t> tail { 0 };
+    std::atomic<int> numPending { 0 };
+    WorkerThread thread { *this };
+
+    static_assert ((kQueueSize & (kQueueSize - 1)) == 0, "Queue size must be a power of two");
+
+    JUCE_DECLARE_NON_COPYABLE (SpectralWorker)
+};
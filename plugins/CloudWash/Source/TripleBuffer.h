@@ -0,0 +1,58 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <cstdint>
+
+//==============================================================================
+/**
+ * Lock-free triple buffer for handing a small struct from one writer thread
+ * (the audio thread) to one reader thread (the message thread).
+ *
+ * The writer fills its private slot and publish() swaps it with the shared
+ * middle slot; the reader swaps the middle slot into its own private slot only
+ * when something new was published. Neither side ever waits, the writer may
+ * publish far more often than the reader looks, and the reader always sees a
+ * complete snapshot: the latest one, never a mix of two.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    /** Writer: the slot to fill before publish(). */
+    T& getWriteBuffer() noexcept { return slots[writeIndex]; }
+
+    /** Writer: makes the write slot the latest snapshot. */
+    void publish() noexcept
+    {
+        const auto previous = middle.exchange ((uint8_t) (writeIndex | kFreshBit), std::memory_order_acq_rel);
+        writeIndex = (uint8_t) (previous & kIndexMask);
+    }
+
+    /** Reader: picks up the latest snapshot if there is one. Returns true if it changed. */
+    bool update() noexcept
+    {
+        if ((middle.load (std::memory_order_relaxed) & kFreshBit) == 0)
+            return false;
+
+        const auto previous = middle.exchange (readIndex, std::memory_order_acq_rel);
+        readIndex = (uint8_t) (previous & kIndexMask);
+        return true;
+    }
+
+    /** Reader: the snapshot picked up by the last update(). */
+    const T& getReadBuffer() const noexcept { return slots[readIndex]; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kFreshBit = 0x4;
+
+    T slots[3] {};
+    uint8_t writeIndex = 0;             // Writer only
+    std::atomic<uint8_t> middle { 1 };  // Shared slot index, plus kFreshBit
+    uint8_t readIndex = 2;              // Reader only
+
+    JUCE_DECLARE_NON_COPYABLE (TripleBuffer)
+};
@@ -88,6 +88,12 @@ class AudioBuffer {
     crossfade_counter_ = 0;
   }
   
+  // Moves the write head as if size samples of silence had been written.
+  // Only valid when the whole buffer already holds silence.
+  inline void Skip(int32_t size) {
+    write_head_ = (write_head_ + size) % size_;
+  }
+  
   inline void Write(float in) {
     if (resolution == RESOLUTION_16_BIT) {
       s16_[write_head_] = stmlib::Clip16(
@@ -277,6 +283,23 @@ class AudioBuffer {
     return ((((a * t) - b_neg) * t + c) * t + x0) * scale;
   }
   
+  // Sample at index, unwrapped and unscaled (multiply by scale()), for
+  // callers that interpolate by themselves.
+  inline int32_t Tap(int32_t index) const {
+    if (resolution == RESOLUTION_16_BIT) {
+      return s16_[index];
+    } else if (resolution == RESOLUTION_8_BIT_MU_LAW) {
+      return MuLaw2Lin(s8_[index]);
+    } else {
+      return s8_[index];
+    }
+  }
+
+  inline float scale() const {
+    return resolution == RESOLUTION_16_BIT ||
+        resolution == RESOLUTION_8_BIT_MU_LAW ? 1.0f / 32768.0f : 1.0f / 128.0f;
+  }
+
   inline int32_t size() const { return size_; }
   inline int32_t head() const { return write_head_; }
   
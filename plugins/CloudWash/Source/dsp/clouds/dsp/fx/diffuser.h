@@ -40,8 +40,9 @@ class Diffuser {
   Diffuser() { }
   ~Diffuser() { }
   
-  void Init(float* buffer) {
-    engine_.Init(buffer);
+  // The buffer holds 2048 * FxMemoryMultiplier(scale) samples.
+  void Init(float* buffer, float sample_rate = kFxReferenceSampleRate) {
+    engine_.Init(buffer, sample_rate / kFxReferenceSampleRate);
   }
   
   void Process(FloatFrame* in_out, size_t size) {
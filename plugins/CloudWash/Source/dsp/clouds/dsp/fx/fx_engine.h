@@ -95,6 +95,17 @@ struct DataType<FORMAT_32_BIT> {
   }
 };
 
+// Delay lengths, offsets and LFO depths are written in samples at the 32kHz
+// rate of the hardware. An engine running at a higher rate is initialized
+// with scale = sample_rate / kFxReferenceSampleRate: every delay line and
+// tap is stretched by that factor, and the delay memory must be
+// FxMemoryMultiplier(scale) times larger than the nominal size.
+constexpr float kFxReferenceSampleRate = 32000.0f;
+
+constexpr size_t FxMemoryMultiplier(float scale) {
+  return scale <= 1.0f ? 1 : scale <= 2.0f ? 2 : scale <= 4.0f ? 4 : 8;
+}
+
 template<
     size_t size,
     Format format = FORMAT_12_BIT>
@@ -104,13 +115,16 @@ class FxEngine {
   FxEngine() { }
   ~FxEngine() { }
 
-  void Init(T* buffer) {
+  void Init(T* buffer, float scale = 1.0f) {
     buffer_ = buffer;
+    scale_ = scale;
+    size_ = static_cast<int32_t>(size * FxMemoryMultiplier(scale));
+    mask_ = size_ - 1;
     Clear();
   }
   
   void Clear() {
-    std::fill(&buffer_[0], &buffer_[size], 0);
+    std::fill(&buffer_[0], &buffer_[size_], 0);
     write_ptr_ = 0;
   }
 
@@ -171,11 +185,7 @@ class FxEngine {
     inline void Write(D& d, int32_t offset, float scale) {
       static_assert(D::base + D::length <= size, "delay memory full");
       T w = DataType<format>::Compress(accumulator_);
-      if (offset == -1) {
-        buffer_[(write_ptr_ + D::base + D::length - 1) & MASK] = w;
-      } else {
-        buffer_[(write_ptr_ + D::base + offset) & MASK] = w;
-      }
+      buffer_[(write_ptr_ + Tap<D>(offset)) & mask_] = w;
       accumulator_ *= scale;
     }
     
@@ -198,12 +208,7 @@ class FxEngine {
     template<typename D>
     inline void Read(D& d, int32_t offset, float scale) {
       static_assert(D::base + D::length <= size, "delay memory full");
-      T r;
-      if (offset == -1) {
-        r = buffer_[(write_ptr_ + D::base + D::length - 1) & MASK];
-      } else {
-        r = buffer_[(write_ptr_ + D::base + offset) & MASK];
-      }
+      T r = buffer_[(write_ptr_ + Tap<D>(offset)) & mask_];
       float r_f = DataType<format>::Decompress(r);
       previous_read_ = r_f;
       accumulator_ += r_f * scale;
@@ -227,11 +232,13 @@ class FxEngine {
     template<typename D>
     inline void Interpolate(D& d, float offset, float scale) {
       static_assert(D::base + D::length <= size, "delay memory full");
+      offset *= scale_;
       MAKE_INTEGRAL_FRACTIONAL(offset);
+      int32_t base = Base<D>();
       float a = DataType<format>::Decompress(
-          buffer_[(write_ptr_ + offset_integral + D::base) & MASK]);
+          buffer_[(write_ptr_ + offset_integral + base) & mask_]);
       float b = DataType<format>::Decompress(
-          buffer_[(write_ptr_ + offset_integral + D::base + 1) & MASK]);
+          buffer_[(write_ptr_ + offset_integral + base + 1) & mask_]);
       float x = a + (b - a) * offset_fractional;
       previous_read_ = x;
       accumulator_ += x * scale;
@@ -242,22 +249,43 @@ class FxEngine {
         D& d, float offset, LFOIndex index, float amplitude, float scale) {
       static_assert(D::base + D::length <= size, "delay memory full");
       offset += amplitude * lfo_value_[index];
+      offset *= scale_;
       MAKE_INTEGRAL_FRACTIONAL(offset);
+      int32_t base = Base<D>();
       float a = DataType<format>::Decompress(
-          buffer_[(write_ptr_ + offset_integral + D::base) & MASK]);
+          buffer_[(write_ptr_ + offset_integral + base) & mask_]);
       float b = DataType<format>::Decompress(
-          buffer_[(write_ptr_ + offset_integral + D::base + 1) & MASK]);
+          buffer_[(write_ptr_ + offset_integral + base + 1) & mask_]);
       float x = a + (b - a) * offset_fractional;
       previous_read_ = x;
       accumulator_ += x * scale;
     }
     
    private:
+    // Position of a delay line, and of a tap in it, once stretched to the
+    // engine's sample rate. Exact integers at scale 1.
+    template<typename D>
+    inline int32_t Base() const {
+      return static_cast<int32_t>(static_cast<int32_t>(D::base) * scale_);
+    }
+
+    template<typename D>
+    inline int32_t Tap(int32_t offset) const {
+      if (offset == -1) {
+        return Base<D>() + \
+            static_cast<int32_t>(static_cast<int32_t>(D::length) * scale_) - 1;
+      } else {
+        return Base<D>() + static_cast<int32_t>(offset * scale_);
+      }
+    }
+
     float accumulator_;
     float previous_read_;
     float lfo_value_[2];
     T* buffer_;
     int32_t write_ptr_;
+    int32_t mask_;
+    float scale_;
 
     DISALLOW_COPY_AND_ASSIGN(Context);
   };
@@ -270,12 +298,14 @@ class FxEngine {
   inline void Start(Context* c) {
     --write_ptr_;
     if (write_ptr_ < 0) {
-      write_ptr_ += size;
+      write_ptr_ += size_;
     }
     c->accumulator_ = 0.0f;
     c->previous_read_ = 0.0f;
     c->buffer_ = buffer_;
     c->write_ptr_ = write_ptr_;
+    c->mask_ = mask_;
+    c->scale_ = scale_;
     if ((write_ptr_ & 31) == 0) {
       c->lfo_value_[0] = lfo_[0].Next();
       c->lfo_value_[1] = lfo_[1].Next();
@@ -286,11 +316,10 @@ class FxEngine {
   }
   
  private:
-  enum {
-    MASK = size - 1
-  };
-  
   int32_t write_ptr_;
+  int32_t size_;
+  int32_t mask_;
+  float scale_;
   T* buffer_;
   stmlib::CosineOscillator lfo_[2];
   
@@ -41,8 +41,11 @@ class PitchShifter {
   PitchShifter() { }
   ~PitchShifter() { }
   
-  void Init(uint16_t* buffer) {
-    engine_.Init(buffer);
+  // The buffer holds 4096 * FxMemoryMultiplier(scale) samples. The window
+  // size stays expressed in 32kHz samples; the engine stretches the taps.
+  void Init(uint16_t* buffer, float sample_rate = kFxReferenceSampleRate) {
+    scale_ = sample_rate / kFxReferenceSampleRate;
+    engine_.Init(buffer, scale_);
     phase_ = 0;
     size_ = 2047.0f;
   }
@@ -65,7 +68,7 @@ class PitchShifter {
     E::Context c;
     engine_.Start(&c);
     
-    phase_ += (1.0f - ratio_) / size_;
+    phase_ += (1.0f - ratio_) / (size_ * scale_);
     if (phase_ >= 1.0f) {
       phase_ -= 1.0f;
     }
@@ -107,6 +110,7 @@ class PitchShifter {
   float phase_;
   float ratio_;
   float size_;
+  float scale_;
   
   DISALLOW_COPY_AND_ASSIGN(PitchShifter);
 };
@@ -40,10 +40,12 @@ class Reverb {
   Reverb() { }
   ~Reverb() { }
   
-  void Init(uint16_t* buffer) {
-    engine_.Init(buffer);
-    engine_.SetLFOFrequency(LFO_1, 0.5f / 32000.0f);
-    engine_.SetLFOFrequency(LFO_2, 0.3f / 32000.0f);
+  // The buffer holds 16384 * FxMemoryMultiplier(scale) samples.
+  void Init(uint16_t* buffer, float sample_rate = kFxReferenceSampleRate) {
+    inv_scale_ = kFxReferenceSampleRate / sample_rate;
+    engine_.Init(buffer, sample_rate / kFxReferenceSampleRate);
+    engine_.SetLFOFrequency(LFO_1, 0.5f / sample_rate);
+    engine_.SetLFOFrequency(LFO_2, 0.3f / sample_rate);
     lp_ = 0.7f;
     diffusion_ = 0.625f;
   }
@@ -151,12 +153,26 @@ class Reverb {
     reverb_time_ = reverb_time;
   }
   
+  // Seconds for the loop to die down by 60dB at the current reverb time: a
+  // round trip through both halves of the loop (about 15360 samples at
+  // 32kHz, as long at every rate) goes through reverb_time_ twice. 0 while
+  // the reverb is not mixed in.
+  inline float decay_time() const {
+    if (amount_ <= 0.0f || reverb_time_ <= 0.0f || reverb_time_ >= 1.0f) {
+      return 0.0f;
+    }
+    const float loop_time = 15360.0f / kFxReferenceSampleRate;
+    return -1.5f * loop_time / log10f(reverb_time_);
+  }
+  
   inline void set_diffusion(float diffusion) {
     diffusion_ = diffusion;
   }
   
+  // Damping coefficient as tuned at 32kHz. The pole is moved so that the
+  // cutoff stays put at other rates.
   inline void set_lp(float lp) {
-    lp_ = lp;
+    lp_ = inv_scale_ == 1.0f ? lp : 1.0f - powf(1.0f - lp, inv_scale_);
   }
   
  private:
@@ -168,6 +184,7 @@ class Reverb {
   float reverb_time_;
   float diffusion_;
   float lp_;
+  float inv_scale_;
   
   float lp_decay_1_;
   float lp_decay_2_;
@@ -24,13 +24,16 @@
 //
 // -----------------------------------------------------------------------------
 //
-// Single grain synthesis.
+// Grain synthesis: the state of a pool of grains, and its overlap-add.
 
 #ifndef CLOUDS_DSP_GRAIN_H_
 #define CLOUDS_DSP_GRAIN_H_
 
 #include "stmlib/stmlib.h"
 
+#include <algorithm>
+#include <bit>
+
 #include "stmlib/dsp/dsp.h"
 
 #include "clouds/dsp/audio_buffer.h"
@@ -39,23 +42,153 @@
 
 namespace clouds {
 
+// Size of the largest grain pool. The hardware plays 32 to 57 grains, by
+// quality; on a desktop CPU the pool can be set well beyond.
+const int32_t kMaxNumGrains = 512;
+const int32_t kGrainMaskWords = kMaxNumGrains / 64;
+
+STATIC_ASSERT(kMaxNumGrains % 64 == 0, grain_pool_size_multiple_of_64);
+
+// Grains rendered side by side, one per lane of the vectorized loops: four
+// SSE or NEON vectors (see GrainPool).
+const int32_t kGrainLanes = 16;
+
 enum GrainQuality {
   GRAIN_QUALITY_LOW,
   GRAIN_QUALITY_MEDIUM,
   GRAIN_QUALITY_HIGH
 };
 
-class Grain {
+// The grain envelope is a triangle tri (0 to 1 and back), shaped by the
+// window shape: below 0.5 it is steepened into a trapezoid by a slope, above
+// it is blended with a raised cosine window by a smoothness. Medium quality
+// grains only get the slope, low quality grains keep the triangle. Every
+// case is the one expression
+//
+//   min(tri * slope, 1) + smoothness * (window(tri) - tri)
+//
+// with slope = 1 or smoothness = 0 when unused.
+inline void GrainEnvelopeShape(
+    float window_shape,
+    GrainQuality quality,
+    float* slope,
+    float* smoothness) {
+  *slope = 1.0f;
+  *smoothness = 0.0f;
+  if (window_shape >= 0.5f) {
+    if (quality == GRAIN_QUALITY_HIGH) {
+      *smoothness = (window_shape - 0.5f) * 2.0f;
+    }
+  } else if (quality >= GRAIN_QUALITY_MEDIUM) {
+    *slope = 0.5f / (window_shape + 0.01f);
+  }
+}
+
+// The raised cosine window of lut_window, 0.5 - 0.5 * cos(pi * x) for x in
+// [0, 1], as a polynomial (a sine's Taylor series, to the 9th order): unlike
+// a table lookup, it vectorizes without gathers. Within 2e-6 of lut_window.
+inline float GrainWindow(float x) {
+  float u = float(M_PI) * (x - 0.5f);
+  float u2 = u * u;
+  float sine = u * (1.0f + u2 * (-1.0f / 6.0f + u2 * (1.0f / 120.0f + \
+      u2 * (-1.0f / 5040.0f + u2 * (1.0f / 362880.0f)))));
+  return 0.5f + 0.5f * sine;
+}
+
+// Renders count samples of a grain envelope, from envelope phase phase
+// advancing by increment. There are no branches nor dependencies between
+// samples, so the compiler vectorizes it along time; only high quality
+// grains with a smooth window take the loop that evaluates the window.
+template<GrainQuality quality>
+inline void RenderGrainEnvelope(
+    float phase,
+    float increment,
+    float slope,
+    float smoothness,
+    float* destination,
+    int32_t count) {
+  if (quality == GRAIN_QUALITY_HIGH && smoothness != 0.0f) {
+    // A smoothness implies a slope of 1.
+    for (int32_t n = 0; n < count; ++n) {
+      float tri = 1.0f - fabsf(
+          1.0f - (phase + static_cast<float>(n) * increment));
+      destination[n] = tri + smoothness * (GrainWindow(tri) - tri);
+    }
+  } else {
+    for (int32_t n = 0; n < count; ++n) {
+      float tri = 1.0f - fabsf(
+          1.0f - (phase + static_cast<float>(n) * increment));
+      destination[n] = std::min(tri * slope, 1.0f);
+    }
+  }
+}
+
+// Interpolates, for one lane, between the taps read for kGrainLanes grains:
+// taps[k][lane] is the lane's k-th sample (1 << quality of them: ZOH, linear
+// or Hermite, as AudioBuffer::Read()), t its fractional position.
+template<GrainQuality quality>
+inline float InterpolateGrainTaps(
+    const int32_t (*taps)[kGrainLanes],
+    int32_t lane,
+    float t) {
+  if (quality == GRAIN_QUALITY_LOW) {
+    return static_cast<float>(taps[0][lane]);
+  } else if (quality == GRAIN_QUALITY_MEDIUM) {
+    const float x0 = static_cast<float>(taps[0][lane]);
+    const float x1 = static_cast<float>(taps[1][lane]);
+    return x0 + (x1 - x0) * t;
+  } else {
+    // Laurent de Soras's Hermite interpolator.
+    const float xm1 = static_cast<float>(taps[0][lane]);
+    const float x0 = static_cast<float>(taps[1][lane]);
+    const float x1 = static_cast<float>(taps[2][lane]);
+    const float x2 = static_cast<float>(taps[3][lane]);
+    const float c = (x1 - xm1) * 0.5f;
+    const float v = x0 - x1;
+    const float w = c + v;
+    const float a = w + v + (x2 - x0) * 0.5f;
+    const float b_neg = w + a;
+    return (((a * t) - b_neg) * t + c) * t + x0;
+  }
+}
+
+// Every grain of a pool, one array per field (structure of arrays). A grain
+// is an index into the arrays.
+//
+// A grain's envelope and play-head advance by a constant step on every
+// sample it renders, so within a block both are computed in closed form
+// rather than accumulated. Grains of a quality are rendered kGrainLanes at a
+// time: every per-sample step (envelope, read position, interpolation, mix)
+// is the same arithmetic on each grain's own fields, without branches, and
+// is vectorized across grains. Only the buffer reads remain scalar. Each lane
+// is mixed into its own accumulator, summed into the output once per block.
+// The few grains left over are rendered one at a time, their envelope
+// vectorized along time (see RenderGrainEnvelope()).
+//
+// Which grains are playing is kept as a bitmask, updated when a grain starts
+// or ends: a free grain is found, and the playing ones are listed, with a
+// count-trailing-zeros per 64 grains rather than a scan of every grain.
+class GrainPool {
  public:
-  Grain() { }
-  ~Grain() { }
+  GrainPool() { }
+  ~GrainPool() { }
 
-  void Init() {
-    active_ = false;
-    envelope_phase_ = 2.0f;
+  // Only the first size grains are ever handed out by FindFree().
+  void Init(int32_t size) {
+    for (int32_t i = 0; i < kMaxNumGrains; ++i) {
+      envelope_phase_[i] = 2.0f;
+      recommended_quality_[i] = GRAIN_QUALITY_LOW;
+    }
+    for (int32_t i = 0; i < kGrainMaskWords; ++i) {
+      int32_t bits = std::min(std::max(size - i * 64, 0), 64);
+      pool_mask_[i] = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+      active_mask_[i] = 0;
+    }
+    num_active_ = 0;
   }
 
   void Start(
+      int32_t index,
       int32_t pre_delay,
       int32_t buffer_size,
       int32_t start,
@@ -65,139 +198,309 @@ class Grain {
       float gain_l,
       float gain_r,
       GrainQuality recommended_quality) {
-    pre_delay_ = pre_delay;
-    width_ = width;
-    first_sample_ = (start + buffer_size) % buffer_size;
-    phase_increment_ = phase_increment;
-    phase_ = 0;
-    envelope_phase_ = 0.0f;
-    envelope_phase_increment_ = 2.0f / static_cast<float>(width);
-    if (window_shape >= 0.5f) {
-      envelope_smoothness_ = (window_shape - 0.5f) * 2.0f;
-      envelope_slope_ = 0.0f;
-    } else {
-      envelope_smoothness_ = 0.0f;
-      envelope_slope_ = 0.5f / (window_shape + 0.01f);
+    pre_delay_[index] = pre_delay;
+    first_sample_[index] = (start + buffer_size) % buffer_size;
+    phase_increment_[index] = phase_increment;
+    phase_[index] = 0;
+    envelope_phase_[index] = 0.0f;
+    envelope_phase_increment_[index] = 2.0f / static_cast<float>(width);
+    GrainEnvelopeShape(
+        window_shape,
+        recommended_quality,
+        &envelope_slope_[index],
+        &envelope_smoothness_[index]);
+    active_mask_[index >> 6] |= 1ULL << (index & 63);
+    ++num_active_;
+    gain_l_[index] = gain_l;
+    gain_r_[index] = gain_r;
+    recommended_quality_[index] = recommended_quality;
+  }
+
+  inline int32_t num_active() const { return num_active_; }
+
+  // Playing grains, 64 per word: bit i of word w is grain 64 * w + i.
+  inline uint64_t active_mask(int32_t word) const {
+    return active_mask_[word];
+  }
+
+  // Lowest-numbered grain of the pool that is not playing. There must be
+  // one.
+  inline int32_t FindFree() const {
+    int32_t word = 0;
+    uint64_t free = pool_mask_[0] & ~active_mask_[0];
+    while (!free) {
+      ++word;
+      free = pool_mask_[word] & ~active_mask_[word];
     }
-    active_ = true;
-    gain_l_ = gain_l;
-    gain_r_ = gain_r;
-    recommended_quality_ = recommended_quality;
+    return word * 64 + std::countr_zero(free);
   }
-  
-  template<bool use_lut_for_envelope, GrainQuality quality>
-  inline void RenderEnvelope(float* destination, size_t size) {
-    const float increment = envelope_phase_increment_;
-    const float smoothness = envelope_smoothness_;
-    const float slope = envelope_slope_;
-
-    float phase = envelope_phase_;
-    while (size--) {
-      float gain = phase;
-      gain = gain >= 1.0f ? 2.0f - gain : gain;
-      if (use_lut_for_envelope) {
-        if (quality == GRAIN_QUALITY_HIGH) {
-          float window = 0.0f;
-          window = stmlib::Interpolate(lut_window, gain, 4096.0f);
-          gain += smoothness * (window - gain);
+
+  inline GrainQuality recommended_quality(int32_t index) const {
+    return recommended_quality_[index];
+  }
+
+  // Renders the grains listed in indices, all of the given quality, and
+  // adds them to the interleaved stereo destination: kGrainLanes at a time,
+  // then the remaining ones one by one (a lane group with unused lanes costs
+  // nearly as much as a full one).
+  template<int32_t num_channels, GrainQuality quality, Resolution resolution>
+  void OverlapAdd(
+      const AudioBuffer<resolution>* buffer,
+      const int32_t* indices,
+      int32_t num_grains,
+      float* destination,
+      size_t size) {
+    int32_t i = 0;
+    if (num_grains >= kGrainLanes) {
+      float mix[2][kMaxBlockSize][kGrainLanes];
+      std::fill(&mix[0][0][0], &mix[0][0][0] + size * kGrainLanes, 0.0f);
+      std::fill(&mix[1][0][0], &mix[1][0][0] + size * kGrainLanes, 0.0f);
+      for (; i + kGrainLanes <= num_grains; i += kGrainLanes) {
+        RenderLanes<num_channels, quality>(buffer, &indices[i], mix, size);
+      }
+      for (size_t n = 0; n < size; ++n) {
+        float l = 0.0f;
+        float r = 0.0f;
+        for (int32_t lane = 0; lane < kGrainLanes; ++lane) {
+          l += mix[0][n][lane];
+          r += mix[1][n][lane];
         }
+        destination[2 * n] += l;
+        destination[2 * n + 1] += r;
+      }
+    }
+    for (; i < num_grains; ++i) {
+      Render<num_channels, quality>(buffer, indices[i], destination, size);
+    }
+  }
+
+ private:
+  // Renders kGrainLanes grains, one per lane, and adds each of them to its
+  // lane of mix.
+  template<int32_t num_channels, GrainQuality quality, Resolution resolution>
+  inline void RenderLanes(
+      const AudioBuffer<resolution>* buffer,
+      const int32_t* indices,
+      float (*mix)[kMaxBlockSize][kGrainLanes],
+      size_t size) {
+    const int32_t block_size = static_cast<int32_t>(size);
+
+    int32_t begin[kGrainLanes];
+    int32_t end[kGrainLanes];
+    int32_t first_sample[kGrainLanes];
+    uint32_t phase[kGrainLanes];
+    uint32_t phase_increment[kGrainLanes];
+    float envelope_phase[kGrainLanes];
+    float increment[kGrainLanes];
+    float slope[kGrainLanes];
+    float smoothness[kGrainLanes];
+    float gain_l[kGrainLanes];
+    float gain_r[kGrainLanes];
+    int32_t first_live = block_size;  // Samples any lane renders
+    int32_t last_live = 0;
+    for (int32_t lane = 0; lane < kGrainLanes; ++lane) {
+      const int32_t index = indices[lane];
+
+      // As in Render().
+      begin[lane] = std::min(pre_delay_[index], block_size);
+      pre_delay_[index] -= begin[lane];
+      envelope_phase[lane] = envelope_phase_[index];
+      increment[lane] = envelope_phase_increment_[index];
+      const int32_t available = block_size - begin[lane];
+      int32_t count = 0;
+      for (int32_t n = 0; n < available; ++n) {
+        count += envelope_phase[lane] + \
+            static_cast<float>(n + 1) * increment[lane] < 2.0f;
+      }
+      end[lane] = begin[lane] + count;
+      first_live = std::min(first_live, begin[lane]);
+      last_live = std::max(last_live, end[lane]);
+
+      first_sample[lane] = first_sample_[index];
+      phase[lane] = static_cast<uint32_t>(phase_[index]);
+      phase_increment[lane] = static_cast<uint32_t>(phase_increment_[index]);
+      slope[lane] = envelope_slope_[index];
+      smoothness[lane] = envelope_smoothness_[index];
+      gain_l[lane] = gain_l_[index];
+      gain_r[lane] = gain_r_[index];
+
+      envelope_phase_[index] = envelope_phase[lane] + \
+          static_cast<float>(count) * increment[lane];
+      phase_[index] = static_cast<int32_t>(
+          phase[lane] + static_cast<uint32_t>(count) * phase_increment[lane]);
+      if (count < available) {
+        active_mask_[index >> 6] &= ~(1ULL << (index & 63));
+        --num_active_;
+      }
+    }
+
+    // Scaling of the buffer's samples, folded into the mix.
+    const float scale = buffer[0].scale();
+    float left_to_left[kGrainLanes];
+    float left_to_right[kGrainLanes];
+    float right_to_left[kGrainLanes];
+    float right_to_right[kGrainLanes];
+    for (int32_t lane = 0; lane < kGrainLanes; ++lane) {
+      if (num_channels == 1) {
+        left_to_left[lane] = gain_l[lane] * scale;
+        left_to_right[lane] = gain_r[lane] * scale;
       } else {
-        if (quality >= GRAIN_QUALITY_MEDIUM) {
-          gain *= slope;
-          if (gain >= 1.0f) gain = 1.0f;
+        left_to_left[lane] = gain_l[lane] * scale;
+        left_to_right[lane] = (1.0f - gain_l[lane]) * scale;
+        right_to_left[lane] = (1.0f - gain_r[lane]) * scale;
+        right_to_right[lane] = gain_r[lane] * scale;
+      }
+    }
+
+    // Sample by sample, each step runs across the lanes: the envelope and
+    // read position (closed form, as in RenderGrainEnvelope()), then the
+    // buffer reads - the only scalar step -, then the interpolation and the
+    // mix. A lane outside its grain's [begin, end) reads the grain's current
+    // sample and gets an envelope of 0.
+    const int32_t buffer_size = buffer[0].size();
+    for (int32_t n = first_live; n < last_live; ++n) {
+      int32_t sample_index[kGrainLanes];
+      float t[kGrainLanes];
+      float envelope[kGrainLanes];
+      for (int32_t lane = 0; lane < kGrainLanes; ++lane) {
+        const int32_t m = n - begin[lane];
+        const int32_t live = (m >= 0) & (n < end[lane]);
+        const uint32_t position = phase[lane] + \
+            static_cast<uint32_t>(m & -live) * phase_increment[lane];
+        sample_index[lane] = first_sample[lane] + \
+            static_cast<int32_t>(position >> 16);
+        t[lane] = static_cast<float>(position & 65535) / 65536.0f;
+
+        // The gate is applied within the min(): applied to its result, the
+        // compiler turns the min() into a branch and stops vectorizing.
+        const float gate = static_cast<float>(live);
+        const float tri = 1.0f - fabsf(
+            1.0f - (envelope_phase[lane] + static_cast<float>(m) * \
+                increment[lane]));
+        float shape = std::min(tri * slope[lane] * gate, gate);
+        if (quality == GRAIN_QUALITY_HIGH) {
+          shape += gate * smoothness[lane] * (GrainWindow(tri) - tri);
         }
+        envelope[lane] = shape;
       }
-      phase += increment;
-      if (phase >= 2.0f) {
-        *destination = -1.0f;
-        break;
+
+      int32_t x[num_channels][1 << quality][kGrainLanes];
+      for (int32_t lane = 0; lane < kGrainLanes; ++lane) {
+        int32_t i = sample_index[lane];
+        if (i >= buffer_size) {
+          i -= buffer_size;
+        }
+        for (int32_t channel = 0; channel < num_channels; ++channel) {
+          for (int32_t tap = 0; tap < 1 << quality; ++tap) {
+            x[channel][tap][lane] = buffer[channel].Tap(i + tap);
+          }
+        }
+      }
+
+      for (int32_t lane = 0; lane < kGrainLanes; ++lane) {
+        const float l = InterpolateGrainTaps<quality>(
+            x[0], lane, t[lane]) * envelope[lane];
+        if (num_channels == 1) {
+          mix[0][n][lane] += l * left_to_left[lane];
+          mix[1][n][lane] += l * left_to_right[lane];
+        } else {
+          const float r = InterpolateGrainTaps<quality>(
+              x[num_channels - 1], lane, t[lane]) * envelope[lane];
+          mix[0][n][lane] += l * left_to_left[lane] + r * right_to_left[lane];
+          mix[1][n][lane] += r * right_to_right[lane] + l * left_to_right[lane];
+        }
       }
-      *destination++ = gain;
     }
-    envelope_phase_ = phase;
   }
-  
+
   template<int32_t num_channels, GrainQuality quality, Resolution resolution>
-  inline void OverlapAdd(
+  inline void Render(
       const AudioBuffer<resolution>* buffer,
+      int32_t index,
       float* destination,
-      float* envelope,
       size_t size) {
-    if (!active_) {
-      return;
-    }
-    // Rendering is done on 32-sample long blocks. The pre-delay allows grains
-    // to start at arbitrary samples within a block, rather than at block
-    // boundaries.
-    while (pre_delay_ && size) {
-      destination += 2;
-      --size;
-      --pre_delay_;
-    }
-    
-    // Pre-render the envelope in one pass.
-    if (envelope_smoothness_ == 0.0f) {
-      RenderEnvelope<false, quality>(envelope, size);
-    } else {
-      RenderEnvelope<true, quality>(envelope, size);
+    // Rendering is done on 32-sample long blocks. The pre-delay allows
+    // grains to start at arbitrary samples within a block, rather than at
+    // block boundaries.
+    const int32_t block_size = static_cast<int32_t>(size);
+    const int32_t begin = std::min(pre_delay_[index], block_size);
+    pre_delay_[index] -= begin;
+    destination += 2 * begin;
+
+    // The grain renders sample n as long as its envelope phase after it,
+    // phase + (n + 1) * increment, stays below 2; the sample that would
+    // reach 2 ends the grain and is not rendered.
+    const float envelope_phase = envelope_phase_[index];
+    const float increment = envelope_phase_increment_[index];
+    const int32_t available = block_size - begin;
+    int32_t count = 0;
+    for (int32_t n = 0; n < available; ++n) {
+      count += envelope_phase + static_cast<float>(n + 1) * increment < 2.0f;
     }
-    
-    const int32_t phase_increment = phase_increment_;
-    const int32_t first_sample = first_sample_;
-    const float gain_l = gain_l_;
-    const float gain_r = gain_r_;
-    int32_t phase = phase_;
-    while (size--) {
-      int32_t sample_index = first_sample + (phase >> 16);
-      
-      float gain = *envelope++;
-      if (gain == -1.0f) {
-        active_ = false;
-        break;
-      }
 
+    float gain[kMaxBlockSize];
+    RenderGrainEnvelope<quality>(
+        envelope_phase,
+        increment,
+        envelope_slope_[index],
+        envelope_smoothness_[index],
+        gain,
+        count);
+
+    const uint32_t phase = static_cast<uint32_t>(phase_[index]);
+    const uint32_t phase_increment = static_cast<uint32_t>(
+        phase_increment_[index]);
+    const int32_t first_sample = first_sample_[index];
+    const float gain_l = gain_l_[index];
+    const float gain_r = gain_r_[index];
+    for (int32_t n = 0; n < count; ++n) {
+      int32_t position = static_cast<int32_t>(
+          phase + static_cast<uint32_t>(n) * phase_increment);
+      int32_t sample_index = first_sample + (position >> 16);
+      uint16_t fractional = position & 65535;
       float l = buffer[0].template Read<InterpolationMethod(quality)>(
-          sample_index, phase & 65535) * gain;
+          sample_index, fractional) * gain[n];
       if (num_channels == 1) {
-        *destination++ += l * gain_l;
-        *destination++ += l * gain_r;
-      } else if (num_channels == 2) {
+        destination[2 * n] += l * gain_l;
+        destination[2 * n + 1] += l * gain_r;
+      } else {
         float r = buffer[1].template Read<InterpolationMethod(quality)>(
-            sample_index, phase & 65535) * gain;
-        *destination++ += l * gain_l + r * (1.0f - gain_r);
-        *destination++ += r * gain_r + l * (1.0f - gain_l);
+            sample_index, fractional) * gain[n];
+        destination[2 * n] += l * gain_l + r * (1.0f - gain_r);
+        destination[2 * n + 1] += r * gain_r + l * (1.0f - gain_l);
       }
-      phase += phase_increment;
     }
-    phase_ = phase;
-  }
-  
-  inline bool active() { return active_; }
-  
-  inline GrainQuality recommended_quality() const {
-    return recommended_quality_;
+
+    envelope_phase_[index] = envelope_phase + static_cast<float>(count) *
+        increment;
+    phase_[index] = static_cast<int32_t>(
+        phase + static_cast<uint32_t>(count) * phase_increment);
+    if (count < available) {
+      active_mask_[index >> 6] &= ~(1ULL << (index & 63));
+      --num_active_;
+    }
   }
 
- private:
-  int32_t first_sample_;
-  int32_t width_;
-  int32_t phase_;
-  int32_t phase_increment_;
-  int32_t pre_delay_;
+  int32_t first_sample_[kMaxNumGrains];
+  int32_t phase_[kMaxNumGrains];
+  int32_t phase_increment_[kMaxNumGrains];
+  int32_t pre_delay_[kMaxNumGrains];
+
+  float envelope_smoothness_[kMaxNumGrains];  // See GrainEnvelopeShape()
+  float envelope_slope_[kMaxNumGrains];
+  float envelope_phase_[kMaxNumGrains];
+  float envelope_phase_increment_[kMaxNumGrains];
 
-  float envelope_smoothness_;
-  float envelope_slope_;
-  float envelope_phase_;
-  float envelope_phase_increment_;
+  float gain_l_[kMaxNumGrains];
+  float gain_r_[kMaxNumGrains];
 
-  float gain_l_;
-  float gain_r_;
+  uint64_t pool_mask_[kGrainMaskWords];
+  uint64_t active_mask_[kGrainMaskWords];
+  int32_t num_active_;
 
-  bool active_;
-  
-  GrainQuality recommended_quality_;
+  GrainQuality recommended_quality_[kMaxNumGrains];
 
-  DISALLOW_COPY_AND_ASSIGN(Grain);
+  DISALLOW_COPY_AND_ASSIGN(GrainPool);
 };
 
 }  // namespace clouds
@@ -53,6 +53,7 @@ void GranularProcessor::Init(
   num_channels_ = 2;
   low_fidelity_ = false;
   bypass_ = false;
+  rate_ratio_ = kFxReferenceSampleRate / base_sample_rate_;
   
   src_down_.Init();
   src_up_.Init();
@@ -61,6 +62,8 @@ void GranularProcessor::Init(
   
   previous_playback_mode_ = PLAYBACK_MODE_LAST;
   reset_buffers_ = true;
+  sleeping_ = false;
+  silent_samples_ = 0;
   dry_wet_ = 0.0f;
 }
 
@@ -156,10 +159,53 @@ void GranularProcessor::ProcessGranular(
   }
 }
 
+void GranularProcessor::Sleep(size_t size) {
+  // The recording holds nothing but silence: moving the heads along is the
+  // same as recording more of it.
+  if (playback_mode_ != PLAYBACK_MODE_SPECTRAL) {
+    int32_t skipped = static_cast<int32_t>(size) / \
+        (low_fidelity_ ? kDownsamplingFactor : 1);
+    for (int32_t i = 0; i < num_channels_; ++i) {
+      if (resolution() == 8) {
+        buffer_8_[i].Skip(skipped);
+      } else {
+        buffer_16_[i].Skip(skipped);
+      }
+    }
+  }
+  sleeping_ = true;
+}
+
 void GranularProcessor::Process(
     ShortFrame* input,
     ShortFrame* output,
     size_t size) {
+  // Zeroed past size, so that no part of the block is left uninitialized.
+  FloatFrame in[kMaxBlockSize] = { };
+  FloatFrame out[kMaxBlockSize];
+  for (size_t i = 0; i < size; ++i) {
+    in[i].l = static_cast<float>(input[i].l) / 32768.0f;
+    in[i].r = static_cast<float>(input[i].r) / 32768.0f;
+  }
+  Process(in, out, size);
+  for (size_t i = 0; i < size; ++i) {
+    output[i].l = Clip16(static_cast<int32_t>(out[i].l * 32768.0f));
+    output[i].r = Clip16(static_cast<int32_t>(out[i].r * 32768.0f));
+  }
+}
+
+void GranularProcessor::Process(
+    const FloatFrame* input,
+    FloatFrame* output,
+    size_t size) {
+  Process(input, input, output, size);
+}
+
+void GranularProcessor::Process(
+    const FloatFrame* input,
+    const FloatFrame* record_input,
+    FloatFrame* output,
+    size_t size) {
   // TIC
   if (bypass_) {
     copy(&input[0], &input[size], &output[0]);
@@ -168,16 +214,31 @@ void GranularProcessor::Process(
   
   if (silence_ || reset_buffers_ ||
       previous_playback_mode_ != playback_mode_) {
-    short* output_samples = &output[0].l;
-    fill(&output_samples[0], &output_samples[size << 1], 0);
+    float* output_samples = &output[0].l;
+    fill(&output_samples[0], &output_samples[size << 1], 0.0f);
     return;
   }
   
-  // Convert input buffers to float, and mixdown for mono processing.
+  float input_level = 0.0f;
   for (size_t i = 0; i < size; ++i) {
-    in_[i].l = static_cast<float>(input[i].l) / 32768.0f;
-    in_[i].r = static_cast<float>(input[i].r) / 32768.0f;
+    input_level = max(input_level, max(fabsf(input[i].l), fabsf(input[i].r)));
+    input_level = max(input_level, max(
+        fabsf(record_input[i].l), fabsf(record_input[i].r)));
+  }
+  
+  // Sleep mode: nothing can come out until the input or a trigger does.
+  if (silent_samples_ >= sleep_delay() && !parameters_.freeze &&
+      !parameters_.trigger && input_level < kSleepThreshold) {
+    Sleep(size);
+    float* output_samples = &output[0].l;
+    fill(&output_samples[0], &output_samples[size << 1], 0.0f);
+    return;
   }
+  sleeping_ = false;
+  
+  // Copy input buffers, and mixdown for mono processing. The dry signal used
+  // in the final crossfade is read from input directly.
+  copy(&record_input[0], &record_input[size], &in_[0]);
   if (num_channels_ == 1) {
     for (size_t i = 0; i < size; ++i) {
       in_[i].l = (in_[i].l + in_[i].r) * 0.5f;
@@ -187,7 +248,10 @@ void GranularProcessor::Process(
   
   // Apply feedback, with high-pass filtering to prevent build-ups at very
   // low frequencies (causing large DC swings).
-  ONE_POLE(freeze_lp_, parameters_.freeze ? 1.0f : 0.0f, 0.0005f)
+  ONE_POLE(
+      freeze_lp_,
+      parameters_.freeze ? 1.0f : 0.0f,
+      0.0005f * rate_ratio_)
   float feedback = parameters_.feedback;
   float cutoff = (20.0f + 100.0f * feedback * feedback) / sample_rate();
   fb_filter_[0].set_f_q<FREQUENCY_FAST>(cutoff, 1.0f);
@@ -204,6 +268,7 @@ void GranularProcessor::Process(
   
   if (low_fidelity_) {
     size_t downsampled_size = size / kDownsamplingFactor;
+    parameters_.trigger_delay /= kDownsamplingFactor;  // At the players' rate
     src_down_.Process(in_, in_downsampled_,size);
     ProcessGranular(in_downsampled_, out_downsampled_, downsampled_size);
     src_up_.Process(out_downsampled_, out_, downsampled_size);
@@ -236,6 +301,9 @@ void GranularProcessor::Process(
         (cutoff < 0.5f ? cutoff - 0.5f : 0.0f) * 216.0f);
     float hp_cutoff = 0.25f * SemitonesToRatio(
         (cutoff < 0.5f ? -0.5f : cutoff - 1.0f) * 216.0f);
+    // Cutoffs above are relative to 32kHz.
+    lp_cutoff *= rate_ratio_;
+    hp_cutoff *= rate_ratio_;
     CONSTRAIN(lp_cutoff, 0.0f, 0.499f);
     CONSTRAIN(hp_cutoff, 0.0f, 0.499f);
     float lpq = 1.0f + 3.0f * (1.0f - feedback) * (0.5f - lp_cutoff);
@@ -277,12 +345,25 @@ void GranularProcessor::Process(
     float dry_wet = dry_wet_mod.Next();
     float fade_in = Interpolate(lut_xfade_in, dry_wet, 16.0f);
     float fade_out = Interpolate(lut_xfade_out, dry_wet, 16.0f);
-    float l = static_cast<float>(input[i].l) / 32768.0f * fade_out;
-    float r = static_cast<float>(input[i].r) / 32768.0f * fade_out;
+    float l = input[i].l * fade_out;
+    float r = input[i].r * fade_out;
     l += out_[i].l * post_gain * fade_in;
     r += out_[i].r * post_gain * fade_in;
-    output[i].l = SoftConvert(l);
-    output[i].r = SoftConvert(r);
+    output[i].l = SoftClip(l * 0.5f);
+    output[i].r = SoftClip(r * 0.5f);
+  }
+  
+  // Sleep detection: silent input, and nothing left in the wet path.
+  float level = input_level;
+  for (size_t i = 0; i < size; ++i) {
+    level = max(level, max(fabsf(out_[i].l), fabsf(out_[i].r)));
+  }
+  if (level < kSleepThreshold) {
+    silent_samples_ = min(
+        silent_samples_ + static_cast<int32_t>(size),
+        sleep_delay());
+  } else {
+    silent_samples_ = 0;
   }
 }
 
@@ -400,32 +481,51 @@ void GranularProcessor::Prepare() {
     } else {
       // Large buffer: 64k of sample memory + FX workspace.
       // small buffer: 64k of sample memory.
-      buffer_size[0] = buffer_size[1] = buffer_size_[1];
+      // With larger (heap) buffers the same layout applies; the channel size
+      // is capped so that the workspace always fits after channel 0.
+      size_t workspace_size_needed = WorkspaceSize(base_sample_rate_);
+      size_t channel_size = buffer_size_[1];
+      if (buffer_size_[0] < channel_size + workspace_size_needed) {
+        channel_size = buffer_size_[0] > workspace_size_needed
+            ? buffer_size_[0] - workspace_size_needed
+            : 0;
+      }
+      channel_size &= ~static_cast<size_t>(3);
+      buffer_size[0] = buffer_size[1] = channel_size;
       buffer[0] = buffer_[0];
       buffer[1] = buffer_[1];
       
-      workspace_size = buffer_size_[0] - buffer_size_[1];
+      workspace_size = buffer_size_[0] - channel_size;
       workspace = static_cast<uint8_t*>(buffer[0]) + buffer_size[0];
     }
     float sr = sample_rate();
+    size_t fx_memory_multiplier = FxMemoryMultiplier(
+        base_sample_rate_ / kFxReferenceSampleRate);
 
     BufferAllocator allocator(workspace, workspace_size);
-    diffuser_.Init(allocator.Allocate<float>(2048));
-    reverb_.Init(allocator.Allocate<uint16_t>(16384));
+    diffuser_.Init(
+        allocator.Allocate<float>(2048 * fx_memory_multiplier),
+        base_sample_rate_);
+    reverb_.Init(
+        allocator.Allocate<uint16_t>(16384 * fx_memory_multiplier),
+        base_sample_rate_);
     
+    // The pitch shifter's delay line shares the correlator's memory.
     size_t correlator_block_size = (kMaxWSOLASize / 32) + 2;
-    uint32_t* correlator_data = allocator.Allocate<uint32_t>(
-        correlator_block_size * 3);
+    uint32_t* correlator_data = allocator.Allocate<uint32_t>(max(
+        correlator_block_size * 3,
+        PitchShifterWorkspaceSize(base_sample_rate_) / sizeof(uint32_t)));
     correlator_.Init(
         &correlator_data[0],
         &correlator_data[correlator_block_size]);
-    pitch_shifter_.Init((uint16_t*)correlator_data);
+    pitch_shifter_.Init((uint16_t*)correlator_data, base_sample_rate_);
     
     if (playback_mode_ == PLAYBACK_MODE_SPECTRAL) {
       phase_vocoder_.Init(
           buffer, buffer_size,
           lut_sine_window_4096, 4096,
-          num_channels_, resolution(), sr);
+          num_channels_, resolution(), sr,
+          async_spectral_ ? 1 : 0);
     } else {
       for (int32_t i = 0; i < num_channels_; ++i) {
         if (resolution() == 8) {
@@ -440,13 +540,18 @@ void GranularProcessor::Prepare() {
               tail_buffer_[i]);
         }
       }
-      int32_t num_grains = (num_channels_ == 1 ? 40 : 32) * \
-          (low_fidelity_ ? 23 : 16) >> 4;
-      player_.Init(num_channels_, num_grains);
+      int32_t num_hardware_grains = \
+          (num_channels_ == 1 ? 40 : 32) * (low_fidelity_ ? 23 : 16) >> 4;
+      int32_t num_grains = grain_pool_size_ > 0
+          ? min(grain_pool_size_, kMaxNumGrains)
+          : num_hardware_grains;
+      player_.Init(num_channels_, num_grains, num_hardware_grains);
+      player_.set_grain_size_scale(1.0f / rate_ratio_);
       ws_player_.Init(&correlator_, num_channels_);
       looper_.Init(num_channels_);
     }
     reset_buffers_ = false;
+    silent_samples_ = 0;
     previous_playback_mode_ = playback_mode_;
   }
   
@@ -48,6 +48,34 @@ namespace clouds {
 
 const int32_t kDownsamplingFactor = 2;
 
+// Bytes of the large buffer set aside in Prepare() for the FX: diffuser,
+// reverb, and the WSOLA correlator, whose memory the pitch shifter reuses as
+// its 4096-sample delay line. The FX delay memory grows with the engine's
+// sample rate (see FxMemoryMultiplier). Init() accepts buffers of any size;
+// in stereo, each channel gets the small buffer's size as long as the large
+// one holds that plus this workspace. In mono the small buffer must hold it.
+const size_t kCorrelatorWorkspaceSize = \
+    ((kMaxWSOLASize / 32) + 2) * 3 * sizeof(uint32_t);
+
+constexpr size_t PitchShifterWorkspaceSize(float sample_rate) {
+  return 4096 * sizeof(uint16_t) * \
+      FxMemoryMultiplier(sample_rate / kFxReferenceSampleRate);
+}
+
+constexpr size_t WorkspaceSize(float sample_rate) {
+  return (2048 * sizeof(float) + 16384 * sizeof(uint16_t)) * \
+      FxMemoryMultiplier(sample_rate / kFxReferenceSampleRate) + \
+      (kCorrelatorWorkspaceSize > PitchShifterWorkspaceSize(sample_rate)
+          ? kCorrelatorWorkspaceSize
+          : PitchShifterWorkspaceSize(sample_rate));
+}
+
+const size_t kWorkspaceSize = WorkspaceSize(kFxReferenceSampleRate);
+
+// Below this level (about -100 dB), input and output count as silence for
+// the sleep mode.
+const float kSleepThreshold = 1.0e-5f;
+
 enum PlaybackMode {
   PLAYBACK_MODE_GRANULAR,
   PLAYBACK_MODE_STRETCH,
@@ -72,7 +100,10 @@ struct PersistentBlock {
 
 class GranularProcessor {
  public:
-  GranularProcessor() { }
+  GranularProcessor()
+      : base_sample_rate_(kFxReferenceSampleRate),
+        async_spectral_(false),
+        grain_pool_size_(0) { }
   ~GranularProcessor() { }
   
   void Init(
@@ -82,14 +113,60 @@ class GranularProcessor {
       size_t small_buffer_size);
 
   void Process(ShortFrame* input, ShortFrame* output, size_t size);
+  // Float-native entry point: the whole chain, including the dry/wet stage,
+  // stays in float. Output is soft-clipped to [-1, 1] with the same curve as
+  // the 16-bit path.
+  void Process(const FloatFrame* input, FloatFrame* output, size_t size);
+  // Same, recording (and feeding the spectral analysis) from record_input
+  // instead: input only reaches the output through the dry/wet stage.
+  void Process(
+      const FloatFrame* input,
+      const FloatFrame* record_input,
+      FloatFrame* output,
+      size_t size);
   void Prepare();
   
   // CRITICAL FIX: Expose Buffer() for continuous spectral mode processing
   // VCV Rack calls this every 32 samples to ensure proper STFT buffering
-  inline void Buffer() {
-    if (playback_mode_ == PLAYBACK_MODE_SPECTRAL) {
-      phase_vocoder_.Buffer();
+  // Returns true if a frame was transformed. See set_async_spectral().
+  inline bool Buffer() {
+    return playback_mode_ == PLAYBACK_MODE_SPECTRAL && phase_vocoder_.Buffer();
+  }
+  
+  inline size_t spectral_frames_pending() const {
+    return playback_mode_ == PLAYBACK_MODE_SPECTRAL
+        ? phase_vocoder_.num_pending_frames()
+        : 0;
+  }
+  
+  // Running count of completed frames, to tell when a new one is ready.
+  inline size_t spectral_frames_ready() const {
+    return playback_mode_ == PLAYBACK_MODE_SPECTRAL
+        ? phase_vocoder_.num_ready_frames()
+        : 0;
+  }
+  
+  // With async spectral processing, Buffer() may run on another thread than
+  // Process(), up to a hop behind it; the phase vocoder then has one more
+  // hop of latency (see spectral_latency()). Takes effect at the next
+  // buffer reset.
+  inline void set_async_spectral(bool async_spectral) {
+    async_spectral_ = async_spectral;
+  }
+  
+  // Frames that may be left pending when Process() is called: the frame it
+  // completes must not overwrite the input of one still being transformed.
+  inline size_t max_spectral_frames_pending() const {
+    return async_spectral_ ? 1 : 0;
+  }
+  
+  // Latency added by async spectral processing, in samples at the base rate.
+  inline int32_t spectral_latency() const {
+    if (playback_mode_ != PLAYBACK_MODE_SPECTRAL || !async_spectral_) {
+      return 0;
     }
+    return static_cast<int32_t>(phase_vocoder_.hop_size()) * \
+        (low_fidelity_ ? kDownsamplingFactor : 1);
   }
   
   inline Parameters* mutable_parameters() {
@@ -116,6 +193,33 @@ class GranularProcessor {
     silence_ = silence;
   }
   
+  // Maximum grain quality regardless of the grain count, for offline
+  // rendering. The other modes already read the buffer with Hermite
+  // interpolation.
+  inline void set_high_quality(bool high_quality) {
+    player_.set_high_quality(high_quality);
+  }
+  
+  // Number of grains the granular mode can play at once, up to
+  // kMaxNumGrains; 0 for the hardware's count, which depends on the quality.
+  // Takes effect at the next Prepare() that re-initializes the buffers.
+  inline void set_grain_pool_size(int32_t size) {
+    grain_pool_size_ = size;
+  }
+  
+  // Share of the grain pool the CPU budget allows (see GranularSamplePlayer).
+  inline void set_grain_budget(float budget) {
+    player_.set_grain_budget(budget);
+  }
+  
+  // Seeds every random draw of this processor. Processors with the same
+  // seed, fed the same input and parameters, render the same output. Not
+  // reset by Prepare().
+  inline void Seed(uint32_t seed) {
+    player_.Seed(seed);
+    phase_vocoder_.Seed(seed);
+  }
+  
   inline void set_bypass(bool bypass) {
     bypass_ = bypass;
   }
@@ -145,6 +249,22 @@ class GranularProcessor {
     low_fidelity_ = low_fidelity;
   }
   
+  // Forces the next Prepare() to re-initialize every buffer, even for a
+  // "benign" mode change that would otherwise keep the recording.
+  inline void ResetBuffers() {
+    reset_buffers_ = true;
+  }
+  
+  // Rate at which Process() is called. Defaults to the 32kHz of the
+  // hardware; takes effect at the next Init().
+  inline void set_sample_rate(float sample_rate) {
+    base_sample_rate_ = sample_rate;
+  }
+
+  inline float base_sample_rate() const {
+    return base_sample_rate_;
+  }
+  
   inline int32_t quality() const {
     int32_t quality = 0;
     if (num_channels_ == 1) quality |= 1;
@@ -152,6 +272,51 @@ class GranularProcessor {
     return quality;
   }
   
+  // Grain pool of the granular mode, as of the last Process() call.
+  inline const GranularSamplePlayerState& grain_state() const {
+    return player_.state();
+  }
+  
+  // Position of the record head in the recording buffer, in samples.
+  // Both are 0 in spectral mode, which has no such buffer.
+  inline int32_t write_head() const {
+    if (playback_mode_ == PLAYBACK_MODE_SPECTRAL) {
+      return 0;
+    }
+    return low_fidelity_ ? buffer_8_[0].head() : buffer_16_[0].head();
+  }
+  
+  inline int32_t recording_buffer_size() const {
+    if (playback_mode_ == PLAYBACK_MODE_SPECTRAL) {
+      return 0;
+    }
+    return low_fidelity_ ? buffer_8_[0].size() : buffer_16_[0].size();
+  }
+  
+  // Samples of silent input and output after which the engine sleeps: the
+  // whole recording (or STFT window) has been overwritten with silence, and
+  // one more second lets the reverb, diffuser and pitch shifter ring out.
+  // Asleep, Process() only moves the record heads along and outputs silence,
+  // until the input or a trigger wakes it. Frozen, it never sleeps.
+  inline int32_t sleep_delay() const {
+    int32_t window = playback_mode_ == PLAYBACK_MODE_SPECTRAL
+        ? static_cast<int32_t>(kMaxFftSize) * 2
+        : recording_buffer_size();
+    return window * (low_fidelity_ ? kDownsamplingFactor : 1) + \
+        static_cast<int32_t>(base_sample_rate_);
+  }
+  
+  // How long the reverb rings on once its input stops, in seconds, as set
+  // by the last Process() call. The engine only starts counting down to
+  // sleep after that.
+  inline float reverb_decay_time() const {
+    return reverb_.decay_time();
+  }
+  
+  inline bool sleeping() const {
+    return sleeping_;
+  }
+  
   void GetPersistentData(PersistentBlock* block, size_t *num_blocks);
   bool LoadPersistentData(const uint32_t* data);
   void PreparePersistentData();
@@ -162,21 +327,28 @@ class GranularProcessor {
   }
 
   inline float sample_rate() const {
-    return 32000.0f / \
+    return base_sample_rate_ / \
         (low_fidelity_ ? kDownsamplingFactor : 1);
   }
      
   void ResetFilters();
   void ProcessGranular(FloatFrame* input, FloatFrame* output, size_t size);
+  void Sleep(size_t size);
 
   PlaybackMode playback_mode_;
   PlaybackMode previous_playback_mode_;
   int32_t num_channels_;
   bool low_fidelity_;
+  float base_sample_rate_;
+  float rate_ratio_;  // 32kHz / base_sample_rate_
+  bool async_spectral_;
+  int32_t grain_pool_size_;
   
   bool silence_;
   bool bypass_;
   bool reset_buffers_;
+  bool sleeping_;
+  int32_t silent_samples_;
   float freeze_lp_;
   float dry_wet_;
   
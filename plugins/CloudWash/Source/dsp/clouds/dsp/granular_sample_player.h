@@ -32,10 +32,11 @@
 #include "stmlib/stmlib.h"
 
 #include <algorithm>
+#include <bit>
 
 #include "stmlib/dsp/atan.h"
 #include "stmlib/dsp/units.h"
-#include "stmlib/utils/random.h"
+#include "stmlib/utils/counter_random.h"
 
 #include "clouds/dsp/audio_buffer.h"
 #include "clouds/dsp/frame.h"
@@ -46,25 +47,71 @@
 
 namespace clouds {
 
-const int32_t kMaxNumGrains = 64;
+const int32_t kMinLiveGrains = 4;  // Whatever the grain budget
 
 using namespace stmlib;
 
+// State of the grain pool at the end of the last Play() call.
+struct GranularSamplePlayerState {
+  int32_t max_num_grains;  // Size of the pool
+  int32_t num_active_grains;
+  int32_t num_grains_per_quality[GRAIN_QUALITY_HIGH + 1];
+  float gain_normalization;
+};
+
 class GranularSamplePlayer {
  public:
-  GranularSamplePlayer() { }
+  GranularSamplePlayer() : high_quality_(false), grain_budget_(1.0f) { }
   ~GranularSamplePlayer() { }
   
-  void Init(int32_t num_channels, int32_t max_num_grains) {
+  // The hardware's pool size for the same quality sets where the gain
+  // normalization of larger pools starts to differ from the hardware's.
+  void Init(
+      int32_t num_channels,
+      int32_t max_num_grains,
+      int32_t num_hardware_grains) {
     max_num_grains_ = max_num_grains;
+    gain_normalization_knee_ = static_cast<float>(num_hardware_grains);
     num_midfi_grains_ = 3 * max_num_grains / 4;
     gain_normalization_ = 1.0f;
-    for (int32_t i = 0; i < kMaxNumGrains; ++i) {
-      grains_[i].Init();
-    }
+    grains_.Init(max_num_grains);
     num_grains_ = 0.0f;
     num_channels_ = num_channels;
     grain_size_hint_ = 1024.0f;
+    grain_size_scale_ = 1.0f;
+    std::fill(
+        &state_.num_grains_per_quality[0],
+        &state_.num_grains_per_quality[GRAIN_QUALITY_HIGH + 1],
+        0);
+    state_.max_num_grains = max_num_grains;
+    state_.num_active_grains = 0;
+    state_.gain_normalization = 1.0f;
+  }
+  
+  // Grain sizes in lut_grain_size are in samples at 32kHz; scale them for a
+  // player running at another rate.
+  inline void set_grain_size_scale(float scale) {
+    grain_size_scale_ = scale;
+  }
+  
+  // New grains all get GRAIN_QUALITY_HIGH (Hermite reads, windowed
+  // envelope), however many are playing. Not reset by Init().
+  inline void set_high_quality(bool high_quality) {
+    high_quality_ = high_quality;
+  }
+  
+  // Share of the pool, in (0, 1], that the host's CPU budget allows. Below
+  // 1, fewer grains may play at once, fewer of them get GRAIN_QUALITY_HIGH,
+  // and the last ones started get GRAIN_QUALITY_LOW. Playing grains keep
+  // their quality. Not reset by Init().
+  inline void set_grain_budget(float budget) {
+    grain_budget_ = budget;
+  }
+  
+  // Grain seeding and panning draw from this player's own random stream.
+  // Not reset by Init().
+  inline void Seed(uint32_t seed) {
+    random_.Seed(seed);
   }
   
   template<Resolution resolution>
@@ -83,73 +130,100 @@ class GranularSamplePlayer {
       grain_rate_phasor_ = -1000.0f;
     }
     
-    // Build a list of available grains.
-    int32_t num_available_grains = FillAvailableGrainsList();
+    int32_t num_available_grains = max_num_grains_ - grains_.num_active();
+    
+    // Grains the budget allows: up to this many playing, the first
+    // num_hifi_grains of them in high quality, the others up to
+    // num_midfi_grains in medium quality, the rest in low quality. With the
+    // full budget, the tiers are the hardware's.
+    float budget = high_quality_ ? 1.0f : grain_budget_;
+    int32_t num_live_grains = std::max(
+        std::min(max_num_grains_, kMinLiveGrains),
+        static_cast<int32_t>(max_num_grains_ * budget));
+    int32_t num_reserved_grains = max_num_grains_ - num_live_grains;
+    int32_t num_hifi_grains = static_cast<int32_t>(
+        (max_num_grains_ - num_midfi_grains_) * budget);
+    int32_t num_midfi_grains = static_cast<int32_t>(
+        num_live_grains * (0.5f + 0.5f * budget));
     
     // Try to schedule new grains.
     bool seed_trigger = parameters.trigger;
+    size_t trigger_delay = static_cast<size_t>(parameters.trigger_delay);
+    float random[kMaxBlockSize];
+    random_.FillFloats(random, size);
     for (size_t t = 0; t < size; ++t) {
       grain_rate_phasor_ += 1.0f;
-      bool seed_probabilistic = Random::GetFloat() < p
+      bool seed_probabilistic = random[t] < p
           && target_num_grains > num_grains_;
       bool seed_deterministic = grain_rate_phasor_ >= space_between_grains;
-      bool seed = seed_probabilistic || seed_deterministic || seed_trigger;
-      if (num_available_grains && seed) {
+      bool trigger_fired = seed_trigger && t >= trigger_delay;
+      bool seed = seed_probabilistic || seed_deterministic || trigger_fired;
+      if (num_available_grains > num_reserved_grains && seed) {
         --num_available_grains;
-        int32_t index = available_grains_[num_available_grains];
+        int32_t index = grains_.FindFree();
+        int32_t num_playing = max_num_grains_ - num_available_grains;
         GrainQuality quality;
-        if (num_available_grains < num_midfi_grains_) {
+        if (high_quality_ || num_playing <= num_hifi_grains) {
+          quality = GRAIN_QUALITY_HIGH;
+        } else if (num_playing <= num_midfi_grains) {
           quality = GRAIN_QUALITY_MEDIUM;
         } else {
-          quality = GRAIN_QUALITY_HIGH;
+          quality = GRAIN_QUALITY_LOW;
         }
         
-        Grain* g = &grains_[index];
         ScheduleGrain(
-            g,
+            index,
             parameters,
             t,
             buffer->size(),
             buffer->head() - size + t,
             quality);
         grain_rate_phasor_ = 0.0f;
-        seed_trigger = false;
+        // A grain seeded before the trigger's sample does not stand for it.
+        if (trigger_fired) {
+          seed_trigger = false;
+        }
       }
     }
     
-    // Overlap grains.
+    // Overlap grains, grouped by quality so that each group renders with a
+    // single interpolation method.
     std::fill(&out[0], &out[size * 2], 0.0f);
-    float* e = envelope_buffer_;
-    for (int32_t i = 0; i < max_num_grains_; ++i) {
-      Grain* g = &grains_[i];
-      if (g->recommended_quality() == GRAIN_QUALITY_HIGH) {
-        if (num_channels_ == 1) {
-          g->OverlapAdd<1, GRAIN_QUALITY_HIGH>(buffer, out, e, size);
-        } else {
-          g->OverlapAdd<2, GRAIN_QUALITY_HIGH>(buffer, out, e, size);
-        }
-      } else if (g->recommended_quality() == GRAIN_QUALITY_MEDIUM) {
-        if (num_channels_ == 1) {
-          g->OverlapAdd<1, GRAIN_QUALITY_MEDIUM>(buffer, out, e, size);
-        } else {
-          g->OverlapAdd<2, GRAIN_QUALITY_MEDIUM>(buffer, out, e, size);
-        }
-      } else {
-        if (num_channels_ == 1) {
-          g->OverlapAdd<1, GRAIN_QUALITY_LOW>(buffer, out, e, size);
-        } else {
-          g->OverlapAdd<2, GRAIN_QUALITY_LOW>(buffer, out, e, size);
-        }
+    int32_t* num_grains_per_quality = state_.num_grains_per_quality;
+    std::fill(
+        &num_grains_per_quality[0],
+        &num_grains_per_quality[GRAIN_QUALITY_HIGH + 1],
+        0);
+    for (int32_t word = 0; word < kGrainMaskWords; ++word) {
+      uint64_t active = grains_.active_mask(word);
+      while (active) {
+        int32_t i = word * 64 + std::countr_zero(active);
+        int32_t quality = grains_.recommended_quality(i);
+        render_list_[quality][num_grains_per_quality[quality]++] = i;
+        active &= active - 1;
       }
     }
+    if (num_channels_ == 1) {
+      OverlapAdd<1>(buffer, out, size);
+    } else {
+      OverlapAdd<2>(buffer, out, size);
+    }
     
-    // Compute normalization factor.
+    // Compute normalization factor. Uncorrelated grains add up in power,
+    // which 1 / sqrt(n) compensates; grains reading the same material in
+    // step add up in amplitude. Past the hardware's pool size, the gain
+    // falls as n^-3/4, halfway between the two, so that a large pool is
+    // neither much louder nor much quieter than the hardware's. Up to it,
+    // which is all a hardware-sized pool reaches, it is the hardware's.
     int32_t active_grains = max_num_grains_ - num_available_grains;
     SLOPE(num_grains_, static_cast<float>(active_grains), 0.9f, 0.2f);
 
     float gain_normalization = num_grains_ > 2.0f
         ? fast_rsqrt_carmack(num_grains_ - 1.0f)
         : 1.0f;  
+    if (num_grains_ > gain_normalization_knee_) {
+      gain_normalization *= sqrtf(sqrtf(gain_normalization_knee_ / num_grains_));
+    }
     float window_gain = 1.0f + 2.0f * parameters.granular.window_shape;
     CONSTRAIN(window_gain, 1.0f, 2.0f);
     gain_normalization *= Crossfade(
@@ -161,22 +235,35 @@ class GranularSamplePlayer {
       *out++ *= gain_normalization_;
       *out++ *= gain_normalization_;
     }
+    
+    state_.num_active_grains = active_grains;
+    state_.gain_normalization = gain_normalization_;
+  }
+  
+  inline const GranularSamplePlayerState& state() const {
+    return state_;
   }
   
  private:
-  int32_t FillAvailableGrainsList() {
-    int32_t num_available_grains = 0;
-    for (int32_t i = 0; i < max_num_grains_; ++i) {
-      if (!grains_[i].active()) {
-        available_grains_[num_available_grains] = i;
-        ++num_available_grains;
-      }
-    }
-    return num_available_grains;
+  template<int32_t num_channels, Resolution resolution>
+  void OverlapAdd(
+      const AudioBuffer<resolution>* buffer,
+      float* out,
+      size_t size) {
+    const int32_t* n = state_.num_grains_per_quality;
+    grains_.OverlapAdd<num_channels, GRAIN_QUALITY_HIGH>(
+        buffer, render_list_[GRAIN_QUALITY_HIGH], n[GRAIN_QUALITY_HIGH],
+        out, size);
+    grains_.OverlapAdd<num_channels, GRAIN_QUALITY_MEDIUM>(
+        buffer, render_list_[GRAIN_QUALITY_MEDIUM], n[GRAIN_QUALITY_MEDIUM],
+        out, size);
+    grains_.OverlapAdd<num_channels, GRAIN_QUALITY_LOW>(
+        buffer, render_list_[GRAIN_QUALITY_LOW], n[GRAIN_QUALITY_LOW],
+        out, size);
   }
   
   void ScheduleGrain(
-      Grain* grain,
+      int32_t index,
       const Parameters& parameters,
       int32_t pre_delay,
       int32_t buffer_size,
@@ -185,10 +272,11 @@ class GranularSamplePlayer {
     float position = parameters.position;
     float pitch = parameters.pitch;
     float window_shape = parameters.granular.window_shape;
-    float grain_size = Interpolate(lut_grain_size, parameters.size, 256.0f);
+    float grain_size = Interpolate(lut_grain_size, parameters.size, 256.0f) * \
+        grain_size_scale_;
     float pitch_ratio = SemitonesToRatio(pitch);
     float inv_pitch_ratio = SemitonesToRatio(-pitch);
-    float pan = 0.5f + parameters.stereo_spread * (Random::GetFloat() - 0.5f);
+    float pan = 0.5f + parameters.stereo_spread * (random_.GetFloat() - 0.5f);
     float gain_l, gain_r;
     if (num_channels_ == 1) {
       gain_l = Interpolate(lut_sin, pan, 256.0f);
@@ -222,7 +310,8 @@ class GranularSamplePlayer {
     int32_t size = static_cast<int32_t>(grain_size) & ~1;
     int32_t start = buffer_head - static_cast<int32_t>(
         position * available + eaten_by_play_head);
-    grain->Start(
+    grains_.Start(
+        index,
         pre_delay,
         buffer_size,
         start,
@@ -241,12 +330,19 @@ class GranularSamplePlayer {
 
   float num_grains_;
   float gain_normalization_;
+  float gain_normalization_knee_;  // Grains
   float grain_size_hint_;
+  float grain_size_scale_;
   float grain_rate_phasor_;
+  bool high_quality_;
+  float grain_budget_;
+  
+  stmlib::CounterRandom random_;
+  
+  GrainPool grains_;
+  int32_t render_list_[GRAIN_QUALITY_HIGH + 1][kMaxNumGrains];
   
-  Grain grains_[kMaxNumGrains];
-  int32_t available_grains_[kMaxNumGrains];
-  float envelope_buffer_[kMaxBlockSize];
+  GranularSamplePlayerState state_;
   
   DISALLOW_COPY_AND_ASSIGN(GranularSamplePlayer);
 };
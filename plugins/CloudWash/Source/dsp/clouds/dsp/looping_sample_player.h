@@ -80,8 +80,11 @@ class LoopingSamplePlayer {
       synchronized_ = false;
     }
     if (parameters.trigger) {
-      tap_delay_ = tap_delay_counter_;
-      tap_delay_counter_ = 0;
+      // Count the tap interval from the sample the trigger fell on.
+      int32_t after_trigger = static_cast<int32_t>(size) - \
+          parameters.trigger_delay;
+      tap_delay_ = tap_delay_counter_ - after_trigger;
+      tap_delay_counter_ = after_trigger;
       synchronized_ = tap_delay_ > 128;
       loop_reset_ = phase_;
       phase_ = 0.0f;
@@ -96,8 +99,11 @@ class LoopingSamplePlayer {
         float error = (target_delay - current_delay_);
         float delay = current_delay_ + 0.00005f * error;
         current_delay_ = delay;
-        int32_t delay_int = (buffer->head() - 4 - size + buffer->size()) << 12;
-        delay_int -= static_cast<int32_t>(delay * 4096.0f);
+        // 20.12 fixed point overflows 32 bits beyond 2^19 samples of
+        // memory (long-buffer engines), hence the 64-bit intermediate.
+        int64_t delay_int = static_cast<int64_t>(
+            buffer->head() - 4 - size + buffer->size()) << 12;
+        delay_int -= static_cast<int64_t>(delay * 4096.0f);
         
         float l = buffer[0].ReadHermite((delay_int >> 12), delay_int << 4);
         if (num_channels_ == 1) {
@@ -148,8 +154,9 @@ class LoopingSamplePlayer {
           gain = phase_ / tail_duration_;
           CONSTRAIN(gain, 0.0f, 1.0f);
         }
-        int32_t delay_int = (buffer->head() - 4 + buffer->size()) << 12;
-        int32_t position = delay_int - static_cast<int32_t>(
+        int64_t delay_int = static_cast<int64_t>(
+            buffer->head() - 4 + buffer->size()) << 12;
+        int64_t position = delay_int - static_cast<int64_t>(
               (loop_duration_ - phase_ + loop_point_) * 4096.0f);
         float l = buffer[0].ReadHermite((position >> 12), position << 4);
         if (num_channels_ == 1) {
@@ -163,7 +170,7 @@ class LoopingSamplePlayer {
         
         if (gain != 1.0f) {
           gain = 1.0f - gain;
-          int32_t position = delay_int - static_cast<int32_t>(
+          int64_t position = delay_int - static_cast<int64_t>(
                 (-phase_ + tail_start_) * 4096.0f);
         
           float l = buffer[0].ReadHermite((position >> 12), position << 4);
@@ -47,6 +47,9 @@ struct Parameters {
   bool freeze;
   bool trigger;
   bool gate;
+  // Sample of the block on which trigger fires (0 on the hardware, where
+  // triggers are only seen once per block).
+  int32_t trigger_delay;
   
   struct Granular {
     float overlap;
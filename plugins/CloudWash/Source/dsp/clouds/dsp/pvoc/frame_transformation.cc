@@ -32,7 +32,6 @@
 
 #include "stmlib/dsp/atan.h"
 #include "stmlib/dsp/units.h"
-#include "stmlib/utils/random.h"
 
 #include "clouds/dsp/frame.h"
 #include "clouds/dsp/parameters.h"
@@ -129,7 +128,7 @@ void FrameTransformation::Process(
   if (!glitch) {
     // Decide on which glitch algorithm will be used next time... if glitch
     // is enabled on the next frame!
-    glitch_algorithm_ = stmlib::Random::GetSample() & 3;
+    glitch_algorithm_ = random_.GetSample() & 3;
   }
 
   ifft_in[0] = 0.0f;
@@ -187,9 +186,10 @@ void FrameTransformation::SetPhases(
   CONSTRAIN(r, 0.0f, 1.0f);
   r *= r;
   int32_t amount = static_cast<int32_t>(r * 32768.0f);
+  random_.FillSamples(random_samples_, size_);
   for (int32_t i = 0; i < size_; ++i) {
     synthesis_phase[i] += \
-        static_cast<int32_t>(stmlib::Random::GetSample()) * amount >> 14;
+        static_cast<int32_t>(random_samples_[i]) * amount >> 14;
   }
 }
 
@@ -224,8 +224,9 @@ void FrameTransformation::AddGlitch(float* xf_polar) {
       {
         // Create trails
         float held = 0.0;
+        random_.FillSamples(random_samples_, size_);
         for (int32_t i = 0; i < size_; ++i) {
-          if ((stmlib::Random::GetSample() & 15) == 0) {
+          if ((random_samples_[i] & 15) == 0) {
             held = x[i];
           }
           x[i] = held;
@@ -237,7 +238,7 @@ void FrameTransformation::AddGlitch(float* xf_polar) {
     case 1:
       // Spectral shift up with aliasing.
       {
-        float factor = 1.0f + (stmlib::Random::GetSample() & 7) / 4.0f;
+        float factor = 1.0f + (random_.GetSample() & 7) / 4.0f;
         float source = 0.0f;
         for (int32_t i = 0; i < size_; ++i) {
           source += factor;
@@ -264,8 +265,9 @@ void FrameTransformation::AddGlitch(float* xf_polar) {
     case 3:
       {
         // Nasty high-pass
+        random_.FillSamples(random_samples_, size_);
         for (int32_t i = 0; i < size_; ++i) {
-          uint32_t random = stmlib::Random::GetSample() & 15;
+          uint32_t random = random_samples_[i] & 15;
           if (random == 0) {
             x[i] *= static_cast<float>(i) / 16.0f;
           }
@@ -458,9 +460,10 @@ void FrameTransformation::StoreMagnitudes(
     feedback *= 2.0f;
     feedback *= feedback;
     uint16_t threshold = feedback * 65535.0f;
+    random_.FillSamples(random_samples_, size_);
     for (int32_t i = 0; i < size_; ++i) {
       float x = *xf_polar++;
-      float gain = static_cast<uint16_t>(Random::GetSample()) <= threshold
+      float gain = static_cast<uint16_t>(random_samples_[i]) <= threshold
           ? 1.0f : 0.0f;
       a[i] = Crossfade(a[i], x, gain_a * gain);
       b[i] = Crossfade(b[i], x, gain_b * gain);
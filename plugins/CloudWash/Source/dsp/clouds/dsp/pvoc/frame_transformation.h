@@ -30,6 +30,7 @@
 #define CLOUDS_DSP_PVOC_FRAME_TRANSFORMATION_H_
 
 #include "stmlib/stmlib.h"
+#include "stmlib/utils/counter_random.h"
 
 #include "clouds/dsp/pvoc/stft.h"
 
@@ -50,6 +51,12 @@ class FrameTransformation {
   void Init(float* buffer, int32_t fft_size, int32_t num_textures);
   void Reset();
   
+  // Phase randomization and glitches draw from this transformation's own
+  // random stream. Not reset by Init().
+  inline void Seed(uint32_t seed, uint32_t stream) {
+    random_.Seed(seed, stream);
+  }
+  
   void Process(
       const Parameters& parameters,
       float* fft_out,
@@ -92,6 +99,9 @@ class FrameTransformation {
 
   int8_t glitch_algorithm_;
   
+  stmlib::CounterRandom random_;
+  int16_t random_samples_[kMaxFftSize / 2];  // One per bin, filled in bulk
+  
   DISALLOW_COPY_AND_ASSIGN(FrameTransformation);
 };
 
@@ -44,8 +44,10 @@ void PhaseVocoder::Init(
     size_t largest_fft_size,
     int32_t num_channels,
     int32_t resolution,
-    float sample_rate) {
+    float sample_rate,
+    size_t num_extra_hops) {
   num_channels_ = num_channels;
+  busy_.clear();
 
   size_t fft_size = largest_fft_size;
   size_t hop_ratio = 4;
@@ -58,6 +60,9 @@ void PhaseVocoder::Init(
   
   size_t num_textures = kMaxNumTextures;
   size_t texture_size = (fft_size >> 1) - kHighFrequencyTruncation;
+  // The analysis and synthesis buffers hold the FFT size plus 2 hops each,
+  // which leaves room for one extra hop of latency.
+  num_extra_hops = min(num_extra_hops, static_cast<size_t>(1));
   for (int32_t i = 0; i < num_channels_; ++i) {
     short* ana_syn_buffer = allocator[i]->Allocate<short>(
         (fft_size + (fft_size >> 1)) * 2);
@@ -73,7 +78,8 @@ void PhaseVocoder::Init(
         ifft_buffer,
         large_window_lut,
         ana_syn_buffer,
-        &frame_transformation_[i]);
+        &frame_transformation_[i],
+        num_extra_hops);
   }
   for (int32_t i = 0; i < num_channels_; ++i) {
     float* texture_buffer = allocator[i]->Allocate<float>(
@@ -98,10 +104,16 @@ void PhaseVocoder::Process(
   }
 }
 
-void PhaseVocoder::Buffer() {
+bool PhaseVocoder::Buffer() {
+  if (busy_.test_and_set(std::memory_order_acquire)) {
+    return false;
+  }
+  bool processed = false;
   for (int32_t i = 0; i < num_channels_; ++i) {
-    stft_[i].Buffer();
+    processed = stft_[i].Buffer() || processed;
   }
+  busy_.clear(std::memory_order_release);
+  return processed;
 }
 
 }  // namespace clouds
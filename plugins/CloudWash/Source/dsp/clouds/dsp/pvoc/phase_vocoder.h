@@ -31,6 +31,8 @@
 
 #include "stmlib/stmlib.h"
 
+#include <atomic>
+
 #include "stmlib/fft/shy_fft.h"
 
 #include "clouds/dsp/frame.h"
@@ -51,14 +53,36 @@ class PhaseVocoder {
       const float* large_window_lut, size_t largest_fft_size,
       int32_t num_channels,
       int32_t resolution,
-      float sample_rate);
+      float sample_rate,
+      size_t num_extra_hops = 0);
 
   void Process(
       const Parameters& parameters,
       const FloatFrame* input,
       FloatFrame* output,
       size_t size);
-  void Buffer();
+
+  // Transforms one pending frame of each channel. Safe to call from two
+  // threads: while one is at it, the other returns false at once.
+  bool Buffer();
+
+  inline size_t num_pending_frames() const {
+    return stft_[0].num_pending_frames();
+  }
+
+  inline size_t num_ready_frames() const {
+    return stft_[0].num_ready_frames();
+  }
+
+  inline size_t hop_size() const {
+    return stft_[0].hop_size();
+  }
+  
+  // Each channel's transformation gets its own stream of the seed.
+  inline void Seed(uint32_t seed) {
+    frame_transformation_[0].Seed(seed, 1);
+    frame_transformation_[1].Seed(seed, 2);
+  }
   
  private:
   FFT fft_;
@@ -68,6 +92,9 @@ class PhaseVocoder {
 
   int32_t num_channels_;
   
+  // Both channels share the FFT and its buffers.
+  std::atomic_flag busy_;
+  
   DISALLOW_COPY_AND_ASSIGN(PhaseVocoder);
 };
 
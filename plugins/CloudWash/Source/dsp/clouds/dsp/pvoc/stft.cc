@@ -46,14 +46,16 @@ void STFT::Init(
     float* ifft_buffer,
     const float* window_lut,
     short* analysis_synthesis_buffer,
-    Modifier* modifier) {
+    Modifier* modifier,
+    size_t num_extra_hops) {
   fft_size_ = fft_size;
   hop_size_ = hop_size;
+  num_extra_hops_ = num_extra_hops;
   fft_num_passes_ = 0;
   for (size_t t = fft_size; t > 1; t >>= 1) {
     ++fft_num_passes_;
   }
-  buffer_size_ = fft_size_ + hop_size_;
+  buffer_size_ = fft_size_ + hop_size_ * (1 + num_extra_hops_);
   
   fft_ = fft;
 #ifdef USE_ARM_FFT
@@ -72,19 +74,17 @@ void STFT::Init(
   window_stride_ = LUT_SINE_WINDOW_4096_SIZE / fft_size;
   modifier_ = modifier;
   
-  parameters_ = NULL;
-  
   Reset();
 }
 
 void STFT::Reset() {
   buffer_ptr_ = 0;
-  process_ptr_ = (2 * hop_size_) % buffer_size_;
+  process_ptr_ = ((2 + num_extra_hops_) * hop_size_) % buffer_size_;
   block_size_ = 0;
   fill(&analysis_[0], &analysis_[buffer_size_], 0);
   fill(&synthesis_[0], &synthesis_[buffer_size_], 0);
-  ready_ = 0;
-  done_ = 0;
+  ready_.store(0, std::memory_order_relaxed);
+  done_.store(0, std::memory_order_relaxed);
 }
 
 void STFT::Process(
@@ -93,7 +93,6 @@ void STFT::Process(
     float* output,
     size_t size,
     size_t stride) {
-  parameters_ = &parameters;
   while (size) {
     size_t processed = min(size, hop_size_ - block_size_);
     for (size_t i = 0; i < processed; ++i) {
@@ -112,14 +111,17 @@ void STFT::Process(
     }
     if (block_size_ >= hop_size_) {
       block_size_ -= hop_size_;
-      ++ready_;
+      size_t ready = ready_.load(std::memory_order_relaxed);
+      frame_parameters_[ready % kNumFrameSlots] = parameters;
+      ready_.store(ready + 1, std::memory_order_release);
     }
   }
 }
 
-void STFT::Buffer() {
-  if (ready_ == done_) {
-    return;
+bool STFT::Buffer() {
+  size_t done = done_.load(std::memory_order_relaxed);
+  if (ready_.load(std::memory_order_acquire) == done) {
+    return false;
   }
   
   // Copy block to FFT buffer and apply window.
@@ -151,8 +153,11 @@ void STFT::Buffer() {
   }
 #endif  // USE_ARM_FFT
   // Process in the frequency domain.
-  if (modifier_ != NULL && parameters_ != NULL) {
-    modifier_->Process(*parameters_, &fft_out_[0], &ifft_in_[0]);
+  if (modifier_ != NULL) {
+    modifier_->Process(
+        frame_parameters_[done % kNumFrameSlots],
+        &fft_out_[0],
+        &ifft_in_[0]);
   } else {
     copy(&fft_out_[0], &fft_out_[fft_size_], &ifft_in_[0]);
   }
@@ -200,11 +205,12 @@ void STFT::Buffer() {
     w += window_stride_;
   }
 
-  ++done_;
   process_ptr_ += hop_size_;
   if (process_ptr_ >= buffer_size_) {
     process_ptr_ -= buffer_size_;
   }
+  done_.store(done + 1, std::memory_order_release);
+  return true;
 }
 
 }  // namespace clouds
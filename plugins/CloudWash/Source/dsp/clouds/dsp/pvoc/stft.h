@@ -31,6 +31,10 @@
 
 #include "stmlib/stmlib.h"
 
+#include <atomic>
+
+#include "clouds/dsp/parameters.h"
+
 // #define USE_ARM_FFT
 
 #ifdef USE_ARM_FFT
@@ -41,8 +45,6 @@
 
 namespace clouds {
 
-struct Parameters;
-
 const size_t kMaxFftSize = 4096;
 #ifdef USE_ARM_FFT
   typedef arm_rfft_fast_instance_f32 FFT;
@@ -67,7 +69,8 @@ class STFT {
       float* ifft_buffer,
       const float* window_lut,
       short* stft_frame_processor_buffer,
-      Modifier* modifier);
+      Modifier* modifier,
+      size_t num_extra_hops = 0);
 
   void Reset();
 
@@ -78,9 +81,31 @@ class STFT {
       size_t size,
       size_t stride);
 
-  void Buffer();
+  // Processes one pending frame, if any. Process() and Buffer() may run on
+  // different threads (one each), as long as Buffer() keeps up: with
+  // num_extra_hops extra hops of latency, a frame can be num_extra_hops + 1
+  // hops late.
+  bool Buffer();
+
+  // Frames complete in the input but not yet transformed.
+  inline size_t num_pending_frames() const {
+    return ready_.load(std::memory_order_acquire) - \
+        done_.load(std::memory_order_acquire);
+  }
+
+  // Frames completed since the last Reset(). Process() thread only.
+  inline size_t num_ready_frames() const {
+    return ready_.load(std::memory_order_relaxed);
+  }
+
+  inline size_t hop_size() const { return hop_size_; }
   
  private:
+  // Controls as of the completion of each frame, so that a frame is
+  // transformed the same way whenever (and wherever) Buffer() runs.
+  static const size_t kNumFrameSlots = 4;
+
+
   FFT* fft_;
   size_t fft_size_;
   size_t fft_num_passes_;
@@ -101,10 +126,12 @@ class STFT {
   size_t process_ptr_;
   size_t block_size_;
   
-  size_t ready_;
-  size_t done_;
+  size_t num_extra_hops_;
+  
+  std::atomic<size_t> ready_;
+  std::atomic<size_t> done_;
   
-  const Parameters* parameters_;
+  Parameters frame_parameters_[kNumFrameSlots];
   
   Modifier* modifier_;
   
@@ -0,0 +1,271 @@
+// Copyright 2026 Noizefield.
+//
+// Author: CloudWash contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Grain overlap-add benchmark: GrainPool::OverlapAdd(), which renders grains
+// kGrainLanes at a time across SIMD lanes, against the kernel it replaced
+// (one grain at a time, buffer reads through AudioBuffer::Read()). Not part
+// of the plugin build. From Source/dsp:
+//
+//   g++ -O3 -std=c++20 -I. -o grain_overlap_bench
+//       clouds/test/grain_overlap_bench.cc clouds/resources.cc
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "clouds/dsp/audio_buffer.h"
+#include "clouds/dsp/frame.h"
+#include "clouds/dsp/grain.h"
+
+using namespace clouds;
+
+const int32_t kBufferSize = 32768;
+const int32_t kNumBlocks = 256;
+const int32_t kNumPasses = 4;
+const int32_t kNumRuns = 10;
+
+struct BenchGrain {
+  int32_t pre_delay;
+  int32_t start;
+  int32_t width;
+  int32_t phase_increment;
+  float window_shape;
+  float gain_l;
+  float gain_r;
+};
+
+// The previous kernel, on a copy of one grain's state.
+struct ReferenceGrain {
+  bool active;
+  int32_t first_sample;
+  int32_t phase;
+  int32_t phase_increment;
+  int32_t pre_delay;
+  float envelope_phase;
+  float envelope_phase_increment;
+  float envelope_slope;
+  float envelope_smoothness;
+  float gain_l;
+  float gain_r;
+
+  void Start(const BenchGrain& g, GrainQuality quality) {
+    active = true;
+    pre_delay = g.pre_delay;
+    first_sample = (g.start + kBufferSize) % kBufferSize;
+    phase_increment = g.phase_increment;
+    phase = 0;
+    envelope_phase = 0.0f;
+    envelope_phase_increment = 2.0f / static_cast<float>(g.width);
+    GrainEnvelopeShape(
+        g.window_shape, quality, &envelope_slope, &envelope_smoothness);
+    gain_l = g.gain_l;
+    gain_r = g.gain_r;
+  }
+
+  template<int32_t num_channels, GrainQuality quality, Resolution resolution>
+  void Render(
+      const AudioBuffer<resolution>* buffer,
+      float* destination,
+      size_t size) {
+    const int32_t block_size = static_cast<int32_t>(size);
+    const int32_t begin = std::min(pre_delay, block_size);
+    pre_delay -= begin;
+    destination += 2 * begin;
+
+    const int32_t available = block_size - begin;
+    int32_t count = 0;
+    for (int32_t n = 0; n < available; ++n) {
+      count += envelope_phase + static_cast<float>(n + 1) * \
+          envelope_phase_increment < 2.0f;
+    }
+
+    float gain[kMaxBlockSize];
+    RenderGrainEnvelope<quality>(
+        envelope_phase,
+        envelope_phase_increment,
+        envelope_slope,
+        envelope_smoothness,
+        gain,
+        count);
+
+    const uint32_t p = static_cast<uint32_t>(phase);
+    const uint32_t increment = static_cast<uint32_t>(phase_increment);
+    for (int32_t n = 0; n < count; ++n) {
+      int32_t position = static_cast<int32_t>(
+          p + static_cast<uint32_t>(n) * increment);
+      int32_t sample_index = first_sample + (position >> 16);
+      uint16_t fractional = position & 65535;
+      float l = buffer[0].template Read<InterpolationMethod(quality)>(
+          sample_index, fractional) * gain[n];
+      if (num_channels == 1) {
+        destination[2 * n] += l * gain_l;
+        destination[2 * n + 1] += l * gain_r;
+      } else {
+        float r = buffer[1].template Read<InterpolationMethod(quality)>(
+            sample_index, fractional) * gain[n];
+        destination[2 * n] += l * gain_l + r * (1.0f - gain_r);
+        destination[2 * n + 1] += r * gain_r + l * (1.0f - gain_l);
+      }
+    }
+
+    envelope_phase += static_cast<float>(count) * envelope_phase_increment;
+    phase = static_cast<int32_t>(p + static_cast<uint32_t>(count) * increment);
+    active = count == available;
+  }
+};
+
+int16_t memory[2][kBufferSize];
+int16_t tail[2][kInterpolationTail];
+AudioBuffer<RESOLUTION_16_BIT> buffer[2];
+GrainPool pool;
+
+// Renders kNumBlocks blocks of the grains, started afresh, into out.
+template<int32_t num_channels, GrainQuality quality>
+void Reference(const std::vector<BenchGrain>& grains, float* out) {
+  static ReferenceGrain state[kMaxNumGrains];
+  for (size_t i = 0; i < grains.size(); ++i) {
+    state[i].Start(grains[i], quality);
+  }
+  for (int32_t block = 0; block < kNumBlocks; ++block) {
+    float* destination = &out[block * kMaxBlockSize * 2];
+    std::fill(destination, destination + kMaxBlockSize * 2, 0.0f);
+    for (size_t i = 0; i < grains.size(); ++i) {
+      if (state[i].active) {
+        state[i].Render<num_channels, quality>(
+            buffer, destination, kMaxBlockSize);
+      }
+    }
+  }
+}
+
+template<int32_t num_channels, GrainQuality quality>
+void Pool(const std::vector<BenchGrain>& grains, float* out) {
+  pool.Init(kMaxNumGrains);
+  for (size_t i = 0; i < grains.size(); ++i) {
+    const BenchGrain& g = grains[i];
+    pool.Start(
+        i, g.pre_delay, kBufferSize, g.start, g.width, g.phase_increment,
+        g.window_shape, g.gain_l, g.gain_r, quality);
+  }
+  int32_t indices[kMaxNumGrains];
+  for (int32_t block = 0; block < kNumBlocks; ++block) {
+    float* destination = &out[block * kMaxBlockSize * 2];
+    std::fill(destination, destination + kMaxBlockSize * 2, 0.0f);
+    int32_t num_grains = 0;
+    for (int32_t word = 0; word < kGrainMaskWords; ++word) {
+      for (uint64_t mask = pool.active_mask(word); mask; mask &= mask - 1) {
+        indices[num_grains++] = word * 64 + std::countr_zero(mask);
+      }
+    }
+    pool.OverlapAdd<num_channels, quality>(
+        buffer, indices, num_grains, destination, kMaxBlockSize);
+  }
+}
+
+template<typename Kernel>
+double Time(const std::vector<BenchGrain>& grains, Kernel kernel, float* out) {
+  auto start = std::chrono::steady_clock::now();
+  for (int32_t pass = 0; pass < kNumPasses; ++pass) {
+    kernel(grains, out);
+  }
+  std::chrono::duration<double> elapsed = \
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+template<int32_t num_channels, GrainQuality quality>
+void Report(const char* name, const std::vector<BenchGrain>& grains) {
+  static float a[kNumBlocks * kMaxBlockSize * 2];
+  static float b[kNumBlocks * kMaxBlockSize * 2];
+  // Best of kNumRuns runs of each, interleaved, against the noise of a
+  // shared machine.
+  double reference = 0.0;
+  double overlap_add = 0.0;
+  for (int32_t run = 0; run < kNumRuns; ++run) {
+    double r = Time(grains, Reference<num_channels, quality>, a);
+    double o = Time(grains, Pool<num_channels, quality>, b);
+    reference = run == 0 ? r : std::min(reference, r);
+    overlap_add = run == 0 ? o : std::min(overlap_add, o);
+  }
+  float max_error = 0.0f;
+  for (size_t i = 0; i < kNumBlocks * kMaxBlockSize * 2; ++i) {
+    max_error = std::max(max_error, fabsf(a[i] - b[i]));
+  }
+  double samples = 0.0;
+  for (const BenchGrain& g : grains) {
+    samples += std::min(g.width, kNumBlocks * int32_t(kMaxBlockSize));
+  }
+  samples *= kNumPasses;
+  printf("%zu grains, %s: %.2f ns/grain sample, previously %.2f (%.2fx, "
+         "max error %g)\n",
+         grains.size(),
+         name,
+         overlap_add * 1e9 / samples,
+         reference * 1e9 / samples,
+         reference / overlap_add,
+         max_error);
+}
+
+void Run(const std::vector<BenchGrain>& grains) {
+  Report<1, GRAIN_QUALITY_HIGH>("mono, high", grains);
+  Report<1, GRAIN_QUALITY_MEDIUM>("mono, medium", grains);
+  Report<1, GRAIN_QUALITY_LOW>("mono, low", grains);
+  Report<2, GRAIN_QUALITY_HIGH>("stereo, high", grains);
+  Report<2, GRAIN_QUALITY_MEDIUM>("stereo, medium", grains);
+  Report<2, GRAIN_QUALITY_LOW>("stereo, low", grains);
+}
+
+int main() {
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (int32_t i = 0; i < 2; ++i) {
+    buffer[i].Init(memory[i], kBufferSize, tail[i]);
+    for (int32_t n = 0; n < kBufferSize; ++n) {
+      buffer[i].Write(unit(rng) - 0.5f);
+    }
+  }
+
+  // Grains from 1024 to 8192 samples, all playing for the whole run, pitched
+  // from -2 to +2 octaves, starting anywhere within the first block. Their
+  // reads stay within the buffer.
+  std::vector<BenchGrain> grains(kMaxNumGrains);
+  for (BenchGrain& g : grains) {
+    g.pre_delay = rng() % kMaxBlockSize;
+    g.width = (1024 + rng() % 7168) & ~1;
+    g.phase_increment = static_cast<int32_t>(
+        65536.0f * powf(2.0f, 4.0f * unit(rng) - 2.0f));
+    g.start = rng() % (kBufferSize / 2);
+    g.window_shape = unit(rng);
+    g.gain_l = unit(rng);
+    g.gain_r = unit(rng);
+  }
+  Run(std::vector<BenchGrain>(grains.begin(), grains.begin() + 8));
+  Run(std::vector<BenchGrain>(grains.begin(), grains.begin() + 64));
+  Run(grains);
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Copyright 2026 Noizefield.
+//
+// Author: CloudWash contributors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Counter-based pseudo random number generator.
+//
+// Unlike Random, which is one stream shared by the whole program, every
+// CounterRandom is a stream of its own: the n-th number of a stream is a hash
+// of n and of the stream's key. Instances running on different threads share
+// nothing, a stream replays exactly from its seed, and since each number only
+// depends on its own position, the Fill functions have no dependency between
+// elements and are vectorized by the compiler.
+
+#ifndef STMLIB_UTILS_COUNTER_RANDOM_H_
+#define STMLIB_UTILS_COUNTER_RANDOM_H_
+
+#include "stmlib/stmlib.h"
+
+namespace stmlib {
+
+class CounterRandom {
+ public:
+  CounterRandom() { Seed(0); }
+  ~CounterRandom() { }
+
+  // Streams with the same seed but another stream number are independent.
+  inline void Seed(uint32_t seed, uint32_t stream = 0) {
+    key_ = Hash(Hash(seed) + stream);
+    counter_ = 0;
+  }
+
+  inline uint32_t GetWord() {
+    return Word(counter_++);
+  }
+
+  inline int16_t GetSample() {
+    return static_cast<int16_t>(GetWord() >> 16);
+  }
+
+  // In [0, 1), with 24 bits of resolution.
+  inline float GetFloat() {
+    return static_cast<float>(GetWord() >> 8) * (1.0f / 16777216.0f);
+  }
+
+  // The next size numbers of the stream, as GetWord() would return them.
+  inline void FillWords(uint32_t* destination, size_t size) {
+    const uint32_t counter = counter_;
+    for (size_t i = 0; i < size; ++i) {
+      destination[i] = Word(counter + static_cast<uint32_t>(i));
+    }
+    counter_ += static_cast<uint32_t>(size);
+  }
+
+  inline void FillSamples(int16_t* destination, size_t size) {
+    const uint32_t counter = counter_;
+    for (size_t i = 0; i < size; ++i) {
+      destination[i] = static_cast<int16_t>(
+          Word(counter + static_cast<uint32_t>(i)) >> 16);
+    }
+    counter_ += static_cast<uint32_t>(size);
+  }
+
+  inline void FillFloats(float* destination, size_t size) {
+    const uint32_t counter = counter_;
+    for (size_t i = 0; i < size; ++i) {
+      destination[i] = static_cast<float>(
+          Word(counter + static_cast<uint32_t>(i)) >> 8) * \
+          (1.0f / 16777216.0f);
+    }
+    counter_ += static_cast<uint32_t>(size);
+  }
+
+ private:
+  // Integer hash with a good avalanche (lowbias32, by Chris Wellons).
+  static inline uint32_t Hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+  }
+
+  // Consecutive counters are spread by the golden ratio before hashing.
+  inline uint32_t Word(uint32_t counter) const {
+    return Hash(key_ + counter * 0x9e3779b9U);
+  }
+
+  uint32_t key_;
+  uint32_t counter_;
+
+  DISALLOW_COPY_AND_ASSIGN(CounterRandom);
+};
+
+}  // namespace stmlib
+
+#endif  // STMLIB_UTILS_COUNTER_RANDOM_H_
@@ -352,8 +352,8 @@ function initializeDropdowns() {
         const value = parseInt(e.target.value);
         if (parameterStates.quality) {
             try {
-                // Quality: 0-3 → normalize to 0-1
-                parameterStates.quality.setNormalisedValue(value / 3.0);
+                // Quality: 0-4 → normalize to 0-1
+                parameterStates.quality.setNormalisedValue(value / 4.0);
             } catch (error) {
                 console.warn(`Failed to set quality: ${error.message}`);
             }
@@ -378,7 +378,7 @@ function initializeDropdowns() {
             // Use correct API: addValueChangedListener (not valueChangedEvent.addListener)
             parameterStates.quality.addValueChangedListener(() => {
                 const normalizedValue = parameterStates.quality.getNormalisedValue();
-                qualitySelect.value = Math.round(normalizedValue * 3.0);
+                qualitySelect.value = Math.round(normalizedValue * 4.0);
             });
         } catch (error) {
             console.warn(`Failed to add quality listener: ${error.message}`);